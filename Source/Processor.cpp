@@ -1,11 +1,17 @@
 #include "Processor.h"
+#if !PPDHeadless
 #include "Editor.h"
+#endif
 
 namespace audio
 {
     juce::AudioProcessorEditor* Processor::createEditor()
     {
+#if PPDHeadless
+        return nullptr;
+#else
         return new gui::Editor(*this);
+#endif
     }
 
     juce::AudioProcessor::BusesProperties ProcessorBackEnd::makeBusesProperties()
@@ -25,7 +31,8 @@ namespace audio
     ProcessorBackEnd::ProcessorBackEnd() :
         juce::AudioProcessor(makeBusesProperties()),
         playHeadPos(),
-        props(),
+        sharedProps(),
+        props(sharedProps->props),
         sus(*this),
         state(),
 #if PPDHasTuningEditor
@@ -47,27 +54,15 @@ namespace audio
 #endif
 #if PPDHasLookahead
 		, lookaheadEnabled(false)
+		, lookaheadRequested(false)
+		, latencyBase(0)
+		, latencyLookahead(0)
 #endif
-		, midiVoices(midiManager)
+		, midiVoices()
 #if PPDHasTuningEditor
         , tuningEditorSynth(xenManager)
 #endif
     {
-        {
-            juce::PropertiesFile::Options options;
-            options.applicationName = JucePlugin_Name;
-            options.filenameSuffix = ".settings";
-            options.folderName = "Mrugalla" + juce::File::getSeparatorString() + JucePlugin_Name;
-            options.osxLibrarySubFolder = "Application Support";
-            options.commonToAllUsers = false;
-            options.ignoreCaseOfKeyNames = false;
-            options.doNotSave = false;
-            options.millisecondsBeforeSaving = 20;
-            options.storageFormat = juce::PropertiesFile::storeAsXML;
-
-            props.setStorageParameters(options);
-        }
-
         {
             playHeadPos.bpm = 120.;
             playHeadPos.ppqPosition = 0.;
@@ -80,9 +75,10 @@ namespace audio
 
     ProcessorBackEnd::~ProcessorBackEnd()
     {
+        // written by the shared props' thread right away, or when the last instance is gone
         auto user = props.getUserSettings();
         user->setValue("firstTimeUwU", false);
-        user->save();
+        sharedProps->flush();
     }
 
     const String ProcessorBackEnd::getName() const
@@ -188,13 +184,20 @@ namespace audio
         bool shallForcePrepare = false;
 #if PPDHasHQ
         const auto ovsrEnabled = params[PID::HQ]->getValMod() > .5f;
-        if (oversampler.isEnabled() != ovsrEnabled)
+        const auto ovsrOrder = static_cast<int>(std::round(params[PID::HQFactor]->getValModDenorm()));
+        const auto ovsrMinPhase = params[PID::HQMinPhase]->getValMod() > .5f;
+        if (oversampler.isEnabled() != ovsrEnabled ||
+            (ovsrEnabled && (oversampler.getOrder() != ovsrOrder || oversampler.isMinimumPhase() != ovsrMinPhase)))
             shallForcePrepare = true;
 #endif
 #if PPDHasLookahead
+		// lookahead doesn't need a prepareToPlay, because the delay lines are allocated for it
 		const auto _lookaheadEnabled = params[PID::Lookahead]->getValMod() > .5f;
-		if (lookaheadEnabled != _lookaheadEnabled)
-			shallForcePrepare = true;
+		if (lookaheadRequested.load() != _lookaheadEnabled)
+		{
+			lookaheadRequested.store(_lookaheadEnabled);
+			setLatencySamples(latencyBase + (_lookaheadEnabled ? latencyLookahead : 0));
+		}
 #endif
 
         if (!shallForcePrepare)
@@ -205,8 +208,6 @@ namespace audio
 
     void ProcessorBackEnd::processBlockBypassed(AudioBuffer& buffer, juce::MidiBuffer&)
     {
-        macroProcessor();
-
         auto mainBus = getBus(true, 0);
         auto mainBuffer = mainBus->getBusBuffer(buffer);
 
@@ -235,16 +236,22 @@ namespace audio
         oscope(),
         lowerLimit(0.f), upperLimit(1.f),
         wetLatencyCompensation(),
-        midiDelay()
-    {}
+        midiDelay(),
+        voiceMix(),
+        ccOutput(),
+        automationBufs()
+    {
+    }
 
     void Processor::prepareToPlay(double sampleRate, int maxBlockSize)
     {
         auto latency = 0.f;
-        //auto sampleRateUp = sampleRate;
+        [[maybe_unused]] auto sampleRateUp = sampleRate;
         auto blockSizeUp = maxBlockSize;
 #if PPDHasHQ
         oversampler.setEnabled(params[PID::HQ]->getValMod() > .5f);
+        oversampler.setOrder(static_cast<int>(std::round(params[PID::HQFactor]->getValModDenorm())));
+        oversampler.setMinimumPhase(params[PID::HQMinPhase]->getValMod() > .5f);
         oversampler.prepare(sampleRate, maxBlockSize);
         sampleRateUp = oversampler.getFsUp();
         blockSizeUp = oversampler.getBlockSizeUp();
@@ -258,22 +265,38 @@ namespace audio
         const auto sampleRateF = static_cast<float>(sampleRate);
 
         midiVoices.prepare(blockSizeUp);
+        midiManager.midiLearn.prepare(sampleRateF);
 #if PPDHasTuningEditor
 		tuningEditorSynth.prepare(sampleRateF, maxBlockSize);
 #endif
 
 		envGenMIDI.prepare(sampleRateF, maxBlockSize);
+        for (const auto pID : EnvGenAutomatedPIDs)
+            params[pID]->resetAutomation();
+        voiceMix.resize(maxBlockSize);
+        for (auto& buf : automationBufs)
+            buf.resize(maxBlockSize);
+        ccOutput.prepare(sampleRateF, maxBlockSize);
 #if PPDHasLookahead
-		auto envGenLatency = lookaheadEnabled ? msInSamples(envGenMIDI.MaxLatencyMs, sampleRateF) : 0.f;
-        latency += envGenLatency;
-        wetLatencyCompensation.prepare(maxBlockSize, static_cast<int>(std::round(envGenLatency)));
+        // the delay lines are always allocated for the lookahead, so that it can be toggled while processing
+        latencyBase = static_cast<int>(latency);
+		latencyLookahead = static_cast<int>(std::round(msInSamples(envGenMIDI.MaxLatencyMs, sampleRateF)));
+        lookaheadRequested.store(lookaheadEnabled);
+        wetLatencyCompensation.prepare(maxBlockSize, lookaheadEnabled ? latencyLookahead : 0, latencyLookahead,
+            static_cast<int>(std::round(msInSamples(20.f, sampleRateF))));
+        if (lookaheadEnabled)
+            latency += static_cast<float>(latencyLookahead);
 #endif
         oscope.prepare(sampleRateF, maxBlockSize);
         lowerLimit.prepare(sampleRateF, maxBlockSize, 10.f);
 		upperLimit.prepare(sampleRateF, maxBlockSize, 10.f);
 
 		const auto latencyInt = static_cast<int>(latency);
+#if PPDHasLookahead
+        dryWetMix.prepare(sampleRateF, maxBlockSize, latencyInt, latencyBase + latencyLookahead);
+#else
         dryWetMix.prepare(sampleRateF, maxBlockSize, latencyInt);
+#endif
         meters.prepare(sampleRateF, maxBlockSize);
         setLatencySamples(latencyInt);
         sus.prepareToPlay();
@@ -284,13 +307,16 @@ namespace audio
         ///*
         const ScopedNoDenormals noDenormals;
 
-        macroProcessor();
+        const auto& prms = macroProcessor();
 
         auto mainBus = getBus(true, 0);
         auto mainBuffer = mainBus->getBusBuffer(buffer);
         
         if (sus.suspendIfNeeded(mainBuffer))
             return;
+#if PPDHasLookahead
+        applyLookahead();
+#endif
 
         const auto numSamples = mainBuffer.getNumSamples();
         if (numSamples == 0)
@@ -299,15 +325,15 @@ namespace audio
 #if PPDHasTuningEditor
         xenManager
         (
-            std::round(params[PID::Xen]->getValModDenorm()),
-            params[PID::MasterTune]->getValModDenorm(),
-            std::round(params[PID::BaseNote]->getValModDenorm())
+            std::round(prms.getValModDenorm(PID::Xen)),
+            prms.getValModDenorm(PID::MasterTune),
+            std::round(prms.getValModDenorm(PID::BaseNote))
         );
 
 
-        midiVoices.pitchbendRange = std::round(params[PID::PitchbendRange]->getValModDenorm());
+        midiVoices.pitchbendRange = std::round(prms.getValModDenorm(PID::PitchbendRange));
 #endif	
-        midiManager(midi, numSamples);
+        midiManager(midi, numSamples, midiVoices);
 		
         const auto _playHead = getPlayHead();
         const auto _playHeadPos = _playHead->getPosition();
@@ -321,7 +347,7 @@ namespace audio
 			playHeadPos.timeInSamples = *_playHeadPos->getTimeInSamples();
         }
 
-        if (params[PID::Power]->getValMod() < .5f)
+        if (prms.getValMod(PID::Power) < .5f)
             return processBlockBypassed(buffer, midi);
 
         const auto samples = mainBuffer.getArrayOfWritePointers();
@@ -331,7 +357,7 @@ namespace audio
         const auto numChannels = mainBuffer.getNumChannels();
 
 #if PPD_MixOrGainDry
-        bool muteDry = params[PID::MuteDry]->getValMod() > .5f;
+        bool muteDry = prms.getValMod(PID::MuteDry) > .5f;
 #endif
         dryWetMix.saveDry
         (
@@ -341,18 +367,18 @@ namespace audio
 #if PPDHasGainIn
             params[PID::GainIn]->getValueDenorm(),
 #if PPDHasUnityGain
-            params[PID::UnityGain]->getValMod(),
+            prms.getValMod(PID::UnityGain),
 #endif
 #endif
 #if PPD_MixOrGainDry == 0
-            params[PID::Mix]->getValMod()
+            prms.getValMod(PID::Mix)
 #else
-			, params[PID::Mix]->getValModDenorm()
+			, prms.getValModDenorm(PID::Mix)
 #endif
 #if PPDHasGainOut
-            , params[PID::Gain]->getValModDenorm()
+            , prms.getValModDenorm(PID::Gain)
 #if PPDHasPolarity
-            , (params[PID::Polarity]->getValMod() > .5f ? -1.f : 1.f)
+            , (prms.getValMod(PID::Polarity) > .5f ? -1.f : 1.f)
 #endif
 #endif
         );
@@ -362,7 +388,7 @@ namespace audio
 #endif
 
 #if PPDHasStereoConfig
-        midSideEnabled = numChannels == 2 && params[PID::StereoConfig]->getValMod() > .5f;
+        midSideEnabled = numChannels == 2 && prms.getValMod(PID::StereoConfig) > .5f;
         if (midSideEnabled)
         {
             encodeMS(samples, numSamples, 0);
@@ -433,7 +459,7 @@ namespace audio
 #endif
 #if PPDHasClipper
         {
-            const auto isClipping = params[PID::Clipper]->getValMod() > .5f ? 1.f : 0.f;
+            const auto isClipping = prms.getValMod(PID::Clipper) > .5f ? 1.f : 0.f;
             if (isClipping)
             {
                 for (auto ch = 0; ch < numChannels; ++ch)
@@ -454,7 +480,7 @@ namespace audio
             numChannels,
             numSamples
 #if PPDHasDelta
-            , params[PID::Delta]->getValMod() > .5f
+            , prms.getValMod(PID::Delta) > .5f
 #endif
         );
 
@@ -480,11 +506,18 @@ namespace audio
 		const auto numChannels = buffer.getNumChannels();
 		const auto numSamples = buffer.getNumSamples();
 		auto samples = buffer.getArrayOfWritePointers();
+        // the host calls this directly while bypassed, so the snapshot isn't fresh yet
+        const auto& prms = macroProcessor();
 
+#if PPDHasLookahead
+        applyLookahead();
+#endif
+        // consumes the automation events, so that they don't pile up
+        getEnvGenAutomation(numSamples);
         envGenMIDI.processBypassed(numSamples);
         oscope(envGenMIDI.data(), numSamples, playHeadPos);
 
-        const auto mode = static_cast<int>(std::rint(params[PID::EnvGenMode]->getValModDenorm()));
+        const auto mode = static_cast<int>(std::rint(prms.getValModDenorm(PID::EnvGenMode)));
         enum { DirectOut };
 		if(mode == DirectOut)
             for (auto ch = 0; ch < numChannels; ++ch)
@@ -493,12 +526,39 @@ namespace audio
         ProcessorBackEnd::processBlockBypassed(buffer, midi);
     }
 
+#if PPDHasLookahead
+    void Processor::applyLookahead() noexcept
+    {
+        const auto requested = lookaheadRequested.load();
+        if (lookaheadEnabled == requested)
+            return;
+        lookaheadEnabled = requested;
+        const auto lookahead = lookaheadEnabled ? latencyLookahead : 0;
+        wetLatencyCompensation.setLatency(lookahead);
+        dryWetMix.setLatency(latencyBase + lookahead);
+    }
+#endif
+
+    EnvGenAutomation Processor::getEnvGenAutomation(int numSamples) noexcept
+    {
+        EnvGenAutomation automation;
+        for (auto i = 0; i < EnvGenAutomation::NumParams; ++i)
+        {
+            auto buf = automationBufs[i].data();
+            if (params[EnvGenAutomatedPIDs[i]]->getAutomation(buf, numSamples))
+                automation.ramps[i] = buf;
+        }
+        return automation;
+    }
+
     void Processor::processBlockPreUpscaled(float* const* samples, int numChannels, int numSamples,
         MIDIBuffer& midi) noexcept
     {
-        if (params[PID::Lookahead]->getValMod() > .5f)
+        const auto& prms = macroProcessor.snapshot;
+#if PPDHasLookahead
+        wetLatencyCompensation(samples, numChannels, numSamples);
+        if (lookaheadEnabled)
         {
-            wetLatencyCompensation(samples, numChannels, numSamples);
             const auto time = std::round(envGenMIDI.maxLatencySamples - envGenMIDI.getAttackLength(numSamples - 1));
             midiDelay
             (
@@ -507,61 +567,122 @@ namespace audio
                 static_cast<int>(time)
             );
         }
+        else
+            midiDelay.flush(midi);
+#endif
 		
+        const auto automation = getEnvGenAutomation(numSamples);
+
+        //const auto mode = static_cast<int>(std::round(prms.getValModDenorm(PID::EnvGenMode)));
+        const auto mode = static_cast<int>(prms.getValModDenorm(PID::EnvGenMode) + .5f);
+        enum { DirectOut, Gain, MIDICC, NumModes };
+        // every voice sends its cc stream on its own midi channel, so there can't be more voices than channels
+        auto numVoicesP = static_cast<int>(std::round(prms.getValModDenorm(PID::EnvGenVoices)));
+        if (mode == MIDICC)
+            numVoicesP = std::min(numVoicesP, CCOutput::MaxStreams);
+
         envGenMIDI
         (
             midi,
             numSamples,
-            params[PID::EnvGenAttack]->getValModDenorm(),
-			params[PID::EnvGenDecay]->getValModDenorm(),
-			params[PID::EnvGenSustain]->getValMod(),
-			params[PID::EnvGenRelease]->getValModDenorm(),
-			params[PID::EnvGenAtkShape]->getValModDenorm(),
-			params[PID::EnvGenDcyShape]->getValModDenorm(),
-			params[PID::EnvGenRlsShape]->getValModDenorm(),
-			static_cast<int>(std::round(params[PID::EnvGenLegato]->getValModDenorm())),
-			params[PID::EnvGenInverse]->getValModDenorm() > .5f,
-            params[PID::EnvGenVelocity]->getValMod(),
-			params[PID::EnvGenTempoSync]->getValMod() > .5f,
-			params[PID::EnvGenAttackBeats]->getValModDenorm(),
-			params[PID::EnvGenDecayBeats]->getValModDenorm(),
-			params[PID::EnvGenReleaseBeats]->getValModDenorm(),
-            playHeadPos
+            prms.getValModDenorm(PID::EnvGenAttack),
+			prms.getValModDenorm(PID::EnvGenDecay),
+			prms.getValMod(PID::EnvGenSustain),
+			prms.getValModDenorm(PID::EnvGenRelease),
+			prms.getValModDenorm(PID::EnvGenAtkShape),
+			prms.getValModDenorm(PID::EnvGenDcyShape),
+			prms.getValModDenorm(PID::EnvGenRlsShape),
+			static_cast<int>(std::round(prms.getValModDenorm(PID::EnvGenLegato))),
+			numVoicesP,
+			prms.getValModDenorm(PID::EnvGenInverse) > .5f,
+            prms.getValMod(PID::EnvGenVelocity),
+			prms.getValMod(PID::EnvGenTempoSync) > .5f,
+			prms.getValModDenorm(PID::EnvGenAttackBeats),
+			prms.getValModDenorm(PID::EnvGenDecayBeats),
+			prms.getValModDenorm(PID::EnvGenReleaseBeats),
+            playHeadPos,
+            automation
         );
 
         auto envGenData = envGenMIDI.data();
+        auto& poly = envGenMIDI.getPoly();
+        const auto isPoly = envGenMIDI.isPoly();
+        const auto numVoices = poly.getNumVoices();
 
-        const auto lowerLimitBuf = lowerLimit(decibelToGain(params[PID::LowerLimit]->getValModDenorm(), -59.9f), numSamples);
-		const auto upperLimitBuf = upperLimit(decibelToGain(params[PID::UpperLimit]->getValModDenorm(), -59.9f), numSamples);
-        for (auto s = 0; s < numSamples; ++s)
-			envGenData[s] = lowerLimitBuf[s] + envGenData[s] * (upperLimitBuf[s] - lowerLimitBuf[s]);
+        const auto lowerLimitBuf = lowerLimit(decibelToGain(prms.getValModDenorm(PID::LowerLimit), -59.9f), numSamples);
+		const auto upperLimitBuf = upperLimit(decibelToGain(prms.getValModDenorm(PID::UpperLimit), -59.9f), numSamples);
+        const auto applyLimits = [&](float* data)
+        {
+            for (auto s = 0; s < numSamples; ++s)
+                data[s] = lowerLimitBuf[s] + data[s] * (upperLimitBuf[s] - lowerLimitBuf[s]);
+        };
+        applyLimits(envGenData);
+        // the voices are combined before they are inverted, because idle voices would invert to 1
+        const auto inverse = envGenMIDI.isInverse();
+        const auto mixVoices = [&](float* dest, int ch)
+        {
+            poly.getMax(dest, ch, numChannels, numSamples);
+            if (inverse)
+                EnvGenMIDI::invert(dest, numSamples);
+            applyLimits(dest);
+        };
 
         oscope(envGenMIDI.data(), numSamples, playHeadPos);
 		
-        //const auto mode = static_cast<int>(std::round(params[PID::EnvGenMode]->getValModDenorm()));
-        const auto mode = static_cast<int>(params[PID::EnvGenMode]->getValModDenorm() + .5f);
-        enum { DirectOut, Gain, MIDICC, NumModes };
         int midiCh, midiCC;
+        // polyphonic: channel ch gets the maximum of the voices ch, ch + numChannels, ...
+        // and every voice sends its own cc stream, one midi channel per voice.
         switch (mode)
         {
 		case Gain:
-			for (auto ch = 0; ch < numChannels; ++ch)
-				SIMD::multiply(samples[ch], envGenData, numSamples);
+            if (isPoly)
+                for (auto ch = 0; ch < numChannels; ++ch)
+                {
+                    mixVoices(voiceMix.data(), ch);
+                    SIMD::multiply(samples[ch], voiceMix.data(), numSamples);
+                }
+            else
+			    for (auto ch = 0; ch < numChannels; ++ch)
+				    SIMD::multiply(samples[ch], envGenData, numSamples);
 			break;
 		case MIDICC:
-            midiCh = static_cast<int>(std::round(params[PID::ControllerChannel]->getValModDenorm()));
-            midiCC = static_cast<int>(std::round(params[PID::ControllerCC]->getValModDenorm()));
-            for (auto s = 0; s < numSamples; ++s)
+        {
+            std::array<const float*, EnvGenPoly::MaxVoices> ccStreams;
+            auto numStreams = 1;
+            ccStreams[0] = envGenData;
+            if (isPoly)
             {
-                const auto envScaled = std::round(envGenData[s] * 127.f);
-                const auto val = static_cast<juce::uint8>(envScaled);
-                const auto evt = MIDIMessage::controllerEvent(midiCh, midiCC, val);
-                midi.addEvent(evt, s);
+                // every voice is its own stream, so each one is inverted by itself.
+                // the voices are rendered again in the next block, so they can be changed in place
+                numStreams = numVoices;
+                for (auto v = 0; v < numVoices; ++v)
+                {
+                    auto voice = poly.data(v);
+                    if (inverse)
+                        EnvGenMIDI::invert(voice, numSamples);
+                    applyLimits(voice);
+                    ccStreams[v] = voice;
+                }
             }
+
+            midiCh = static_cast<int>(std::round(prms.getValModDenorm(PID::ControllerChannel)));
+            midiCC = static_cast<int>(std::round(prms.getValModDenorm(PID::ControllerCC)));
+            const auto resolution = static_cast<CCOutput::Resolution>(std::round(prms.getValModDenorm(PID::ControllerResolution)));
+            ccOutput
+            (
+                midi, ccStreams.data(), numStreams, numSamples,
+                midiCh, midiCC, resolution,
+                prms.getValModDenorm(PID::ControllerRate)
+            );
+        }
             break;
         default: // DirectOut
-            for (auto ch = 0; ch < numChannels; ++ch)
-                SIMD::copy(samples[ch], envGenData, numSamples);
+            if (isPoly)
+                for (auto ch = 0; ch < numChannels; ++ch)
+                    mixVoices(samples[ch], ch);
+            else
+                for (auto ch = 0; ch < numChannels; ++ch)
+                    SIMD::copy(samples[ch], envGenData, numSamples);
             break;
         }
     }
@@ -581,24 +702,51 @@ namespace audio
     /////////////////////////////////////////////;
     void Processor::getStateInformation(juce::MemoryBlock& destData)
     {
-        savePatch();
-        state.savePatch(*this, destData);
+        // the params are written to the binary table directly, only the rest goes through the state.
+        // the defaults are in the table too, but they are also shared with other instances
+        params.saveDefaults(props);
+        sharedProps->flush();
+        midiManager.savePatch();
+        envGenMIDI.savePatch(state);
+#if PPDHasTuningEditor
+        tuningEditorSynth.savePatch(state);
+#endif
+        param::patchFormat::write(params, state, destData);
     }
 
     void Processor::setStateInformation(const void* data, int sizeInBytes)
     {
-        state.loadPatch(*this, data, sizeInBytes);
-        loadPatch();
+        using ReadResult = param::patchFormat::ReadResult;
+        const auto result = param::patchFormat::read(params, state, data, sizeInBytes);
+        if (result == ReadResult::NotBinary)
+        {
+            // xml of older versions
+            state.loadPatch(*this, data, sizeInBytes);
+            loadPatch();
+            return;
+        }
+        // a corrupt patch keeps the current one instead of falling back to the stale state
+        if (result == ReadResult::Corrupt)
+            return;
+
+        midiManager.loadPatch();
+        envGenMIDI.loadPatch(state);
+#if PPDHasTuningEditor
+        tuningEditorSynth.loadPatch(state);
+#endif
+        forcePrepareToPlay();
     }
 
     void Processor::savePatch()
     {
         ProcessorBackEnd::savePatch();
+        envGenMIDI.savePatch(state);
     }
 
     void Processor::loadPatch()
     {
         ProcessorBackEnd::loadPatch();
+        envGenMIDI.loadPatch(state);
         forcePrepareToPlay();
     }
 }
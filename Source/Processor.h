@@ -19,8 +19,11 @@
 #include "audio/Filter.h"
 //#include "audio/Delay.h"
 #include "audio/MIDIDelay.h"
+#include "audio/CCOutput.h"
 
 #include "audio/AudioUtils.h"
+#include "param/PatchFormat.h"
+#include "arch/SharedProps.h"
 
 namespace audio
 {
@@ -59,7 +62,8 @@ namespace audio
         juce::AudioProcessor::BusesProperties makeBusesProperties();
 
         PlayHeadPos playHeadPos;
-        AppProps props;
+        juce::SharedResourcePointer<sta::SharedProps> sharedProps;
+        AppProps& props;
         ProcessSuspender sus;
 
         XenManager xenManager;
@@ -87,7 +91,11 @@ namespace audio
         bool midSideEnabled;
 #endif
 #if PPDHasLookahead
+		/* lookaheadEnabled is what the audio thread currently processes,
+		lookaheadRequested is published by the message thread and applied at the next block */
 		bool lookaheadEnabled;
+		std::atomic<bool> lookaheadRequested;
+		int latencyBase, latencyLookahead;
 #endif
 
         JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ProcessorBackEnd)
@@ -104,6 +112,22 @@ namespace audio
 
         void processBlockBypassed(AudioBuffer&, juce::MidiBuffer&) override;
         
+#if PPDHasLookahead
+        /* applies the lookahead state requested by the message thread, crossfading the delay lines */
+        void applyLookahead() noexcept;
+#endif
+
+        // the parameters of EnvGenAutomation, in its order
+        static constexpr std::array<PID, EnvGenAutomation::NumParams> EnvGenAutomatedPIDs =
+        {
+            PID::EnvGenAttack, PID::EnvGenDecay, PID::EnvGenSustain, PID::EnvGenRelease,
+            PID::EnvGenAtkShape, PID::EnvGenDcyShape, PID::EnvGenRlsShape,
+            PID::EnvGenAttackBeats, PID::EnvGenDecayBeats, PID::EnvGenReleaseBeats
+        };
+
+        /* numSamples, drains the automation queues of the envelope generator's parameters */
+        EnvGenAutomation getEnvGenAutomation(int) noexcept;
+
         /* samples, numChannels, numSamples, midi, samplesSC, numChannelsSC */
         void processBlockPreUpscaled(float* const*, int numChannels, int numSamples, juce::MidiBuffer& midi) noexcept;
 
@@ -133,5 +157,8 @@ namespace audio
         PRM lowerLimit, upperLimit;
         LatencyCompensation wetLatencyCompensation;
         MIDIDelay midiDelay;
+        std::vector<float> voiceMix;
+        CCOutput ccOutput;
+        std::array<std::vector<float>, EnvGenAutomation::NumParams> automationBufs;
     };
 }
\ No newline at end of file
@@ -1,8 +1,10 @@
 #include "FormulaParser2.h"
+#include <juce_audio_basics/juce_audio_basics.h>
 #include <random>
 
 namespace fx
 {
+	using SIMD = juce::FloatVectorOperations;
 	using MersenneTwister = std::mt19937;
 	using RandDistribution = std::uniform_real_distribution<float>;
 	
@@ -62,6 +64,8 @@ namespace fx
 			return "Unknown Token.";
 		case ParserErrorType::WroteAmountOfArguments:
 			return "Wrote Amount Of Arguments.";
+		case ParserErrorType::TooComplex:
+			return "Too Complex.";
 		default: return "Unknown Error.";
 		}
 	}
@@ -333,104 +337,119 @@ namespace fx
 		return "";
 	}
 
-	Func getFunc(Operator o)
+	// calls fn with the scalar function of the unary operator o, or with nullptr.
+	// shared by the tokens' funcs and the block kernels of the parser, so that both compute the same.
+	template<typename Fn>
+	static auto withUnary(Operator o, Fn&& fn)
 	{
 		switch (o)
 		{
 		case Operator::Asinh:
-			return [](float v) { return std::asinh(v); };
+			return fn([](float v) { return std::asinh(v); });
 		case Operator::Acosh:
-			return [](float v) { return std::acosh(v); };
+			return fn([](float v) { return std::acosh(v); });
 		case Operator::Atanh:
-			return [](float v) { return std::atanh(v); };
+			return fn([](float v) { return std::atanh(v); });
 		case Operator::Floor:
-			return [](float v) { return std::floor(v); };
+			return fn([](float v) { return std::floor(v); });
 		case Operator::Log10:
-			return [](float v) { return std::log10(v); };
+			return fn([](float v) { return std::log10(v); });
 		case Operator::Noise:
-			return [](float seed)
+			return fn([](float seed)
 			{
 				MersenneTwister mt(static_cast<unsigned int>(seed));
 				RandDistribution dist(-1.f, 1.f);
 
 				return dist(mt) * 2.f - 1.f;
-			};
+			});
 		case Operator::Asin:
-			return [](float v) { return std::asin(v); };
+			return fn([](float v) { return std::asin(v); });
 		case Operator::Acos:
-			return [](float v) { return std::acos(v); };
+			return fn([](float v) { return std::acos(v); });
 		case Operator::Atan:
-			return [](float v) { return std::atan(v); };
+			return fn([](float v) { return std::atan(v); });
 		case Operator::Ceil:
-			return [](float v) { return std::ceil(v); };
+			return fn([](float v) { return std::ceil(v); });
 		case Operator::Cosh:
-			return [](float v) { return std::cosh(v); };
+			return fn([](float v) { return std::cosh(v); });
 		case Operator::Log2:
-			return [](float v) { return std::log2(v); };
+			return fn([](float v) { return std::log2(v); });
 		case Operator::Sinh:
-			return [](float v) { return std::sinh(v); };
+			return fn([](float v) { return std::sinh(v); });
 		case Operator::Sign:
-			return [](float v) { return std::signbit(v) ? -1.f : 1.f; };
+			return fn([](float v) { return std::signbit(v) ? -1.f : 1.f; });
 		case Operator::Sqrt:
-			return [](float v) { return std::sqrt(v); };
+			return fn([](float v) { return std::sqrt(v); });
 		case Operator::Tanh:
-			return [](float v) { return std::tanh(v); };
+			return fn([](float v) { return std::tanh(v); });
 		case Operator::Abs:
-			return [](float v) { return std::abs(v); };
+			return fn([](float v) { return std::abs(v); });
 		case Operator::Cos:
-			return [](float v) { return std::cos(v); };
+			return fn([](float v) { return std::cos(v); });
 		case Operator::Exp:
-			return [](float v) { return std::exp(v); };
+			return fn([](float v) { return std::exp(v); });
 		case Operator::Sin:
-			return [](float v) { return std::sin(v); };
+			return fn([](float v) { return std::sin(v); });
 		case Operator::Tan:
-			return [](float v) { return std::tan(v); };
+			return fn([](float v) { return std::tan(v); });
 		case Operator::Log:
-			return [](float v) { return std::log(v); };
+			return fn([](float v) { return std::log(v); });
 		case Operator::Ln:
-			return [](float v) { return std::log(v); };
+			return fn([](float v) { return std::log(v); });
 		default:
-			return nullptr;
+			return fn(nullptr);
 		}
 	}
 
-	Func2 getFunc2(Operator o)
+	// calls fn with the scalar function of the binary operator o, or with nullptr.
+	template<typename Fn>
+	static auto withBinary(Operator o, Fn&& fn)
 	{
 		switch (o)
 		{
 		case Operator::Plus:
-			return [](float a, float b) { return a + b; };
+			return fn([](float a, float b) { return a + b; });
 		case Operator::Minus:
-			return [](float a, float b) { return a - b; };
+			return fn([](float a, float b) { return a - b; });
 		case Operator::Multiply:
-			return [](float a, float b) { return a * b; };
+			return fn([](float a, float b) { return a * b; });
 		case Operator::Divide:
-			return [](float a, float b)
+			return fn([](float a, float b)
 			{
 				if (b == 0.f)
 					b = std::numeric_limits<float>::min();
 				return a / b;
-			};
+			});
 		case Operator::Modulo:
-			return [](float a, float b)
+			return fn([](float a, float b)
 			{
 				if (b == 0.f)
 					b = std::numeric_limits<float>::min();
 				return std::fmod(a, b);
-			};
+			});
 		case Operator::Power:
-			return [](float a, float b)
+			return fn([](float a, float b)
 			{
 				if (a == 0.f)
 					if (b < 0.f)
 						a = std::numeric_limits<float>::min();
 				return std::pow(a, b);
-			};
+			});
 		default:
-			return nullptr;
+			return fn(nullptr);
 		}
 	}
 
+	Func getFunc(Operator o)
+	{
+		return withUnary(o, [](auto f) -> Func { return f; });
+	}
+
+	Func2 getFunc2(Operator o)
+	{
+		return withBinary(o, [](auto f) -> Func2 { return f; });
+	}
+
 	// Token
 	
 	Token::Token(Type _type, const String& text) :
@@ -587,7 +606,8 @@ namespace fx
 
 	Parser::Parser() :
 		errorType(ParserErrorType::NoError),
-		func([](float) { return 0.f; })
+		program(),
+		resultReg(-1)
 	{
 	}
 
@@ -764,50 +784,90 @@ namespace fx
 		DBG(toString(postfix));
 #endif
 
-		// CREATE FUNCTION
-		func = [this, postfix](float x)
+		// COMPILE
+		// every slot of the evaluation stack is a register. constant slots are folded
+		// at compile time and only written to their register when an operator needs them.
+		struct Slot
 		{
-			Tokens stack;
-			float y = 0.f;
-			for (const auto& p : postfix)
+			bool isConst;
+			float value;
+		};
+
+		program.clear();
+		resultReg = -1;
+
+		std::vector<Slot> stack;
+		const auto fail = [&](ParserErrorType type)
+		{
+			program.clear();
+			resultReg = -1;
+			errorType = type;
+			return false;
+		};
+		const auto materialize = [&](int reg)
+		{
+			auto& slot = stack[reg];
+			if (slot.isConst)
 			{
-				switch (p.type)
+				program.push_back({ Instruction::Type::Const, Operator::NumOperators, reg, slot.value });
+				slot.isConst = false;
+			}
+		};
+
+		for (const auto& p : postfix)
+		{
+			const auto reg = static_cast<int>(stack.size());
+			switch (p.type)
+			{
+			case Token::Type::Number:
+				if (reg == MaxRegisters)
+					return fail(ParserErrorType::TooComplex);
+				stack.push_back({ true, p.value });
+				break;
+			case Token::Type::X:
+				if (reg == MaxRegisters)
+					return fail(ParserErrorType::TooComplex);
+				program.push_back({ Instruction::Type::X, Operator::NumOperators, reg, p.value });
+				stack.push_back({ false, 0.f });
+				break;
+			case Token::Type::Operator:
+				if (reg < p.numArguments || p.numArguments == 0)
+					return fail(ParserErrorType::WroteAmountOfArguments);
+
+				if (p.numArguments == 1)
 				{
-				case Token::Type::Number:
-					y = p.value;
-					stack.push_back(p);
-					break;
-				case Token::Type::X:
-					y = x * p.value;
-					stack.push_back({ Token::Type::Number, String(y) });
-					break;
-				case Token::Type::Operator:
-					if (stack.size() < p.numArguments)
+					auto& a = stack[reg - 1];
+					if (a.isConst)
+						a.value = p.func(a.value);
+					else
+						program.push_back({ Instruction::Type::Unary, p.op, reg - 1, 0.f });
+				}
+				else
+				{
+					auto& a = stack[reg - 2];
+					const auto b = stack[reg - 1];
+					if (a.isConst && b.isConst)
+						a.value = p.func2(a.value, b.value);
+					else if (b.isConst)
+						program.push_back({ Instruction::Type::BinaryConst, p.op, reg - 2, b.value });
+					else
 					{
-						errorType = ParserErrorType::WroteAmountOfArguments;
-						return 0.f;
+						materialize(reg - 2);
+						program.push_back({ Instruction::Type::Binary, p.op, reg - 2, 0.f });
 					}
-
-					if (p.numArguments == 1)
-						y = p.func(stack.back().value);
-					else if (p.numArguments == 2)
-						y = p.func2(stack[stack.size() - 2].value, stack.back().value);
-
-					for (auto i = 0; i < p.numArguments; ++i)
-						stack.pop_back();
-
-					stack.push_back({ Token::Type::Number, String(y) });
-					break;
-				default:
-					errorType = ParserErrorType::UnknownToken;
-					return 0.f;
+					stack.pop_back();
 				}
+				break;
+			default:
+				return fail(ParserErrorType::UnknownToken);
 			}
+		}
 
-			if (std::isnan(y) || std::isinf(y))
-				return 0.f;
-			return y;
-		};
+		if (!stack.empty())
+		{
+			resultReg = static_cast<int>(stack.size()) - 1;
+			materialize(resultReg);
+		}
 
 		errorType = ParserErrorType::NoError;
 #if JUCE_DEBUG && DebugFormularParser
@@ -818,7 +878,117 @@ namespace fx
 
 	float Parser::operator()(float x) const noexcept
 	{
-		return func(x);
+		auto y = 0.f;
+		operator()(&x, &y, 1);
+		return y;
+	}
+
+	void Parser::operator()(const float* x, float* y, int numSamples) const noexcept
+	{
+		if (resultReg == -1)
+		{
+			SIMD::fill(y, 0.f, numSamples);
+			return;
+		}
+
+		float regs[MaxRegisters][BlockSize];
+
+		for (auto s = 0; s < numSamples; s += BlockSize)
+		{
+			const auto n = std::min(BlockSize, numSamples - s);
+
+			for (const auto& instr : program)
+			{
+				auto a = regs[instr.reg];
+				switch (instr.type)
+				{
+				case Instruction::Type::Const:
+					SIMD::fill(a, instr.value, n);
+					break;
+				case Instruction::Type::X:
+					SIMD::copyWithMultiply(a, x + s, instr.value, n);
+					break;
+				case Instruction::Type::Unary:
+					processUnary(instr.op, a, n);
+					break;
+				case Instruction::Type::Binary:
+					processBinary(instr.op, a, regs[instr.reg + 1], n);
+					break;
+				case Instruction::Type::BinaryConst:
+					processBinary(instr.op, a, instr.value, n);
+					break;
+				}
+			}
+
+			const auto result = regs[resultReg];
+			auto dest = y + s;
+			for (auto i = 0; i < n; ++i)
+			{
+				const auto r = result[i];
+				dest[i] = std::isnan(r) || std::isinf(r) ? 0.f : r;
+			}
+		}
+	}
+
+	bool Parser::isConstant() const noexcept
+	{
+		for (const auto& instr : program)
+			if (instr.type == Instruction::Type::X)
+				return false;
+		return true;
+	}
+
+	void Parser::processUnary(Operator op, float* a, int n) noexcept
+	{
+		if (op == Operator::Abs)
+			return SIMD::abs(a, a, n);
+
+		withUnary(op, [a, n](auto f)
+		{
+			if constexpr (!std::is_same_v<decltype(f), std::nullptr_t>)
+				for (auto i = 0; i < n; ++i)
+					a[i] = f(a[i]);
+		});
+	}
+
+	void Parser::processBinary(Operator op, float* a, const float* b, int n) noexcept
+	{
+		switch (op)
+		{
+		case Operator::Plus:
+			return SIMD::add(a, b, n);
+		case Operator::Minus:
+			return SIMD::subtract(a, b, n);
+		case Operator::Multiply:
+			return SIMD::multiply(a, b, n);
+		default:
+			withBinary(op, [a, b, n](auto f)
+			{
+				if constexpr (!std::is_same_v<decltype(f), std::nullptr_t>)
+					for (auto i = 0; i < n; ++i)
+						a[i] = f(a[i], b[i]);
+			});
+		}
+	}
+
+	void Parser::processBinary(Operator op, float* a, float b, int n) noexcept
+	{
+		switch (op)
+		{
+		case Operator::Plus:
+			return SIMD::add(a, b, n);
+		case Operator::Minus:
+			return SIMD::add(a, -b, n);
+		case Operator::Multiply:
+			return SIMD::multiply(a, b, n);
+		default:
+			withBinary(op, [a, b, n](auto f)
+			{
+				if constexpr (!std::is_same_v<decltype(f), std::nullptr_t>)
+					for (auto i = 0; i < n; ++i)
+						a[i] = f(a[i], b);
+			});
+		}
 	}
 
 }
\ No newline at end of file
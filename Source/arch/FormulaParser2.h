@@ -30,6 +30,7 @@ namespace fx
 		MismatchedParenthesis,
 		UnknownToken,
 		WroteAmountOfArguments,
+		TooComplex,
 		NumTypes
 	};
 
@@ -130,8 +131,13 @@ namespace fx
 	/* postfix, numElements, likelyX, numMin, numMax */
 	void generateTerm(Tokens&, int, float, float, float);
 
+	// compiles a formula into a flat program of register instructions, that is
+	// evaluated for whole buffers. constant subterms are folded at compile time.
 	struct Parser
 	{
+		static constexpr int MaxRegisters = 64;
+		static constexpr int BlockSize = 32;
+
 		Parser();
 
 		bool operator()(const String&);
@@ -141,10 +147,44 @@ namespace fx
 		
 		/* x */
 		float operator()(float = 0.f) const noexcept;
+
+		/* x, y, numSamples
+		x and y can be the same buffer */
+		void operator()(const float*, float*, int) const noexcept;
+
+		/* true if the formula doesn't depend on x */
+		bool isConstant() const noexcept;
 		
 		ParserErrorType errorType;
 	protected:
-		Func func;
+		struct Instruction
+		{
+			enum class Type
+			{
+				Const, // reg = value
+				X, // reg = x * value
+				Unary, // reg = op(reg)
+				Binary, // reg = op(reg, reg + 1)
+				BinaryConst // reg = op(reg, value)
+			};
+
+			Type type;
+			Operator op;
+			int reg;
+			float value;
+		};
+
+		std::vector<Instruction> program;
+		int resultReg;
+
+		/* op, a, numSamples */
+		static void processUnary(Operator, float*, int) noexcept;
+
+		/* op, a, b, numSamples */
+		static void processBinary(Operator, float*, const float*, int) noexcept;
+
+		/* op, a, b, numSamples */
+		static void processBinary(Operator, float*, float, int) noexcept;
 	};
 }
 
@@ -0,0 +1,54 @@
+#include "SharedProps.h"
+
+namespace sta
+{
+	SharedProps::SharedProps() :
+		juce::Thread(JucePlugin_Name " Settings"),
+		props()
+	{
+		juce::PropertiesFile::Options options;
+		options.applicationName = JucePlugin_Name;
+		options.filenameSuffix = ".settings";
+		options.folderName = "Mrugalla" + juce::File::getSeparatorString() + JucePlugin_Name;
+		options.osxLibrarySubFolder = "Application Support";
+		options.commonToAllUsers = false;
+		options.ignoreCaseOfKeyNames = false;
+		options.doNotSave = false;
+		// never saves by itself, see run()
+		options.millisecondsBeforeSaving = -1;
+		options.storageFormat = juce::PropertiesFile::storeAsXML;
+
+		props.setStorageParameters(options);
+		// opens the file before the thread can touch it
+		props.getUserSettings();
+
+		startThread(juce::Thread::Priority::background);
+	}
+
+	SharedProps::~SharedProps()
+	{
+		stopThread(FlushIntervalMs * 2);
+		saveIfNeeded();
+	}
+
+	void SharedProps::flush() noexcept
+	{
+		notify();
+	}
+
+	void SharedProps::run()
+	{
+		while (!threadShouldExit())
+		{
+			wait(FlushIntervalMs);
+			saveIfNeeded();
+		}
+	}
+
+	void SharedProps::saveIfNeeded()
+	{
+		auto user = props.getUserSettings();
+		if (user != nullptr && user->needsToBeSaved())
+			user->save();
+	}
+}
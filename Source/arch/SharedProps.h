@@ -0,0 +1,29 @@
+#pragma once
+#include <juce_data_structures/juce_data_structures.h>
+
+namespace sta
+{
+	// the user settings, shared by all instances of the plugin in the same process.
+	// changes only mark the file as dirty. a background thread writes it at most
+	// once per FlushIntervalMs, so that instances don't write the same file over and over.
+	// use with juce::SharedResourcePointer
+	struct SharedProps :
+		public juce::Thread
+	{
+		static constexpr int FlushIntervalMs = 2000;
+
+		SharedProps();
+
+		~SharedProps();
+
+		/* writes the pending changes on the background thread as soon as possible */
+		void flush() noexcept;
+
+		juce::ApplicationProperties props;
+
+	protected:
+		void run() override;
+
+		void saveIfNeeded();
+	};
+}
@@ -53,6 +53,12 @@ namespace smooth
 	{
 		SIMD::fill(buffer, curVal, numSamples);
 	}
+
+	template<typename Float>
+	void Block<Float>::jumpTo(Float val) noexcept
+	{
+		curVal = val;
+	}
 	
 	template struct Block<float>;
 	template struct Block<double>;
@@ -129,6 +135,12 @@ namespace smooth
 		eps = static_cast<Float>(0);
 	}
 
+	template<typename Float>
+	void Lowpass<Float>::jumpTo(Float val) noexcept
+	{
+		y1 = val;
+	}
+
 	template<typename Float>
 	void Lowpass<Float>::operator()(Float* buffer, Float val, int numSamples) noexcept
 	{
@@ -202,6 +214,13 @@ namespace smooth
 		block(buffer, numSamples);
 		lowpass(buffer, numSamples);
 	}
+
+	template<typename Float>
+	void Smooth<Float>::jumpTo(Float val) noexcept
+	{
+		block.jumpTo(val);
+		lowpass.jumpTo(val);
+	}
 	
 	template struct Smooth<float>;
 	template struct Smooth<double>;
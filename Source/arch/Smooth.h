@@ -18,6 +18,9 @@ namespace smooth
 		/* buffer, numSamples */
 		void operator()(Float*, int) noexcept;
 
+		/* val */
+		void jumpTo(Float) noexcept;
+
 	protected:
 		Float curVal;
 	};
@@ -51,6 +54,9 @@ namespace smooth
 
 		void reset();
 
+		/* val */
+		void jumpTo(Float) noexcept;
+
 		/* buffer, val, numSamples */
 		void operator()(Float*, Float, int) noexcept;
 		/* buffer, numSamples */
@@ -83,6 +89,9 @@ namespace smooth
 		/* buffer, numSamples */
 		void operator()(Float*, int) noexcept;
 
+		/* val, skips the smoothing */
+		void jumpTo(Float) noexcept;
+
 	protected:
 		Block<Float> block;
 		Lowpass<Float> lowpass;
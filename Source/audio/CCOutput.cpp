@@ -0,0 +1,148 @@
+#include "CCOutput.h"
+
+namespace audio
+{
+	CCOutput::CCOutput() :
+		streams(),
+		vals(),
+		scaled(),
+		evts(),
+		outputBuffer(),
+		Fs(1.f),
+		channel(1),
+		controller(0),
+		resolution(Resolution::Bits7)
+	{
+		reset();
+	}
+
+	void CCOutput::prepare(float _Fs, int blockSize)
+	{
+		Fs = _Fs;
+		for (auto& v : vals)
+			v.resize(blockSize);
+		scaled.resize(blockSize);
+		// nrpn sends up to 4 messages per value. streams that don't fit anymore are delayed
+		evts.clear();
+		evts.reserve(static_cast<size_t>(blockSize) * 4);
+		outputBuffer.ensureSize(static_cast<size_t>(blockSize) * 4 * 16);
+		reset();
+	}
+
+	void CCOutput::operator()(MIDIBuffer& midi, const float* const* envs, int numStreams, int numSamples,
+		int _channel, int _controller, Resolution _resolution, float maxRateHz) noexcept
+	{
+		numStreams = std::min(numStreams, MaxStreams);
+
+		if (_resolution == Resolution::Bits14 && _controller > 31)
+			_resolution = Resolution::Bits7;
+		if (channel != _channel || controller != _controller || resolution != _resolution)
+		{
+			channel = _channel;
+			controller = _controller;
+			resolution = _resolution;
+			reset();
+		}
+
+		const auto maxVal = resolution == Resolution::Bits7 ? 127.f : 16383.f;
+		const auto interval = static_cast<int>(std::ceil(Fs / std::max(maxRateHz, 1.f)));
+
+		// quantize
+		for (auto i = 0; i < numStreams; ++i)
+		{
+			auto v = vals[i].data();
+			SIMD::copy(scaled.data(), envs[i], numSamples);
+			SIMD::clip(scaled.data(), scaled.data(), 0.f, 1.f, numSamples);
+			SIMD::multiply(scaled.data(), maxVal, numSamples);
+			SIMD::add(scaled.data(), .5f, numSamples);
+			for (auto s = 0; s < numSamples; ++s)
+				v[s] = static_cast<int>(scaled[s]);
+		}
+
+		// sample-major, so that the events come out in order
+		evts.clear();
+		for (auto s = 0; s < numSamples; ++s)
+			for (auto i = 0; i < numStreams; ++i)
+			{
+				auto& stream = streams[i];
+				const auto val = vals[i][s];
+				if (val != stream.lastVal && s >= stream.nextSample && evts.size() + 4 <= evts.capacity())
+				{
+					emit(i, val, (channel - 1 + i) % 16 + 1, s);
+					stream.nextSample = s + interval;
+				}
+			}
+
+		for (auto i = 0; i < numStreams; ++i)
+			streams[i].nextSample -= numSamples;
+
+		if (evts.empty())
+			return;
+
+		// merge with the incoming midi, appending in order only
+		outputBuffer.clear();
+		auto e = 0;
+		const auto numEvts = static_cast<int>(evts.size());
+		for (const auto ref : midi)
+		{
+			for (; e < numEvts && evts[e].s < ref.samplePosition; ++e)
+				outputBuffer.addEvent(evts[e].data, 3, evts[e].s);
+			outputBuffer.addEvent(ref.data, ref.numBytes, ref.samplePosition);
+		}
+		for (; e < numEvts; ++e)
+			outputBuffer.addEvent(evts[e].data, 3, evts[e].s);
+
+		midi.swapWith(outputBuffer);
+	}
+
+	void CCOutput::reset() noexcept
+	{
+		for (auto& stream : streams)
+		{
+			stream.lastVal = -1;
+			stream.nextSample = 0;
+		}
+	}
+
+	void CCOutput::emit(int i, int val, int ch, int s) noexcept
+	{
+		auto& stream = streams[i];
+		const auto lastVal = stream.lastVal;
+		stream.lastVal = val;
+
+		switch (resolution)
+		{
+		case Resolution::Bits7:
+			return addCC(s, ch, controller, val);
+		case Resolution::Bits14:
+		{
+			// the lsb alone updates the fine value, if the coarse one didn't change
+			const auto msb = val >> 7;
+			if (lastVal == -1 || (lastVal >> 7) != msb)
+				addCC(s, ch, controller, msb);
+			return addCC(s, ch, controller + 32, val & 127);
+		}
+		case Resolution::NRPN:
+			// the nrpn number is only selected once
+			if (lastVal == -1)
+			{
+				addCC(s, ch, 99, 0);
+				addCC(s, ch, 98, controller);
+			}
+			addCC(s, ch, 6, val >> 7);
+			return addCC(s, ch, 38, val & 127);
+		default:
+			return;
+		}
+	}
+
+	void CCOutput::addCC(int s, int ch, int cc, int val) noexcept
+	{
+		Evt evt;
+		evt.s = s;
+		evt.data[0] = static_cast<juce::uint8>(0xb0 | (ch - 1));
+		evt.data[1] = static_cast<juce::uint8>(cc);
+		evt.data[2] = static_cast<juce::uint8>(val);
+		evts.push_back(evt);
+	}
+}
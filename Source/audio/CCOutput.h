@@ -0,0 +1,60 @@
+#pragma once
+#include "AudioUtils.h"
+
+namespace audio
+{
+	// turns envelopes into midi cc streams.
+	// a controller is only sent when its quantized value changes, and not more often than the max rate.
+	struct CCOutput
+	{
+		// one midi channel per stream, more would overwrite each other's controllers
+		static constexpr int MaxStreams = 16;
+
+		enum class Resolution
+		{
+			Bits7,
+			Bits14, // cc n (msb) and n + 32 (lsb), needs cc [0, 31], else 7 bit
+			NRPN, // nrpn number cc, data entry msb and lsb
+			NumResolutions
+		};
+
+		CCOutput();
+
+		/* Fs, blockSize */
+		void prepare(float, int);
+
+		/* midi, streams, numStreams, numSamples, channel [1, 16], controller [0, 127], resolution, maxRateHz
+		merges the cc events of the streams into midi. stream i is sent on channel + i (wrapping).
+		streams beyond MaxStreams are ignored */
+		void operator()(MIDIBuffer&, const float* const*, int, int, int, int, Resolution, float) noexcept;
+
+	protected:
+		struct Stream
+		{
+			int lastVal, nextSample;
+		};
+
+		struct Evt
+		{
+			int s;
+			juce::uint8 data[3];
+		};
+
+		std::array<Stream, MaxStreams> streams;
+		std::array<std::vector<int>, MaxStreams> vals;
+		std::vector<float> scaled;
+		std::vector<Evt> evts;
+		MIDIBuffer outputBuffer;
+		float Fs;
+		int channel, controller;
+		Resolution resolution;
+
+		void reset() noexcept;
+
+		/* stream, val, channel, s */
+		void emit(int, int, int, int) noexcept;
+
+		/* s, channel, controller, value */
+		void addCC(int, int, int, int) noexcept;
+	};
+}
@@ -21,7 +21,13 @@ namespace audio
 
 	void DryWetMix::prepare(float sampleRate, int blockSize, int latency)
 	{
-		latencyCompensation.prepare(blockSize, latency);
+		prepare(sampleRate, blockSize, latency, latency);
+	}
+
+	void DryWetMix::prepare(float sampleRate, int blockSize, int latency, int maxLatency)
+	{
+		const auto fadeLength = static_cast<int>(std::round(msInSamples(20.f, sampleRate)));
+		latencyCompensation.prepare(blockSize, latency, maxLatency, fadeLength);
 
 #if PPDHasGainIn
 		gainInSmooth.makeFromDecayInMs(20.f, sampleRate);
@@ -36,6 +42,11 @@ namespace audio
 		buffers.setSize(NumBufs, blockSize, false, true, false);
 	}
 
+	void DryWetMix::setLatency(int latency) noexcept
+	{
+		latencyCompensation.setLatency(latency);
+	}
+
 	void DryWetMix::saveDry(float* const* samples, int numChannels, int numSamples,
 #if PPDHasGainIn
 		float gainInP,
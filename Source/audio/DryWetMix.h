@@ -24,6 +24,12 @@ namespace audio
 		/* sampleRate, blockSize, latency */
 		void prepare(float, int, int);
 
+		/* sampleRate, blockSize, latency, maxLatency */
+		void prepare(float, int, int, int);
+
+		/* latency [0, maxLatency], crossfades the dry signal to the new delay */
+		void setLatency(int) noexcept;
+
 		/* samples, numChannels, numSamples, gainInP, unityGainP, mixP, gainOutP, polarityP */
 		void saveDry
 		(
@@ -1,68 +1,257 @@
 #include "EnvelopeFollower.h"
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 
 namespace audio
 {
+	// EnvFol
 
 	EnvFol::EnvFol() :
-		smoothie(0.f),
-		rise(1.f),
-		fall(1.f),
+		riseCoeffs{ 1.f, 0.f },
+		fallCoeffs{ 1.f, 0.f },
+		rise(0.f),
+		fall(0.f),
 		env(0.f),
 		Fs(1.f),
-		state(State::Fall)
+		rising(false)
 	{}
 
 	void EnvFol::prepare(float _Fs) noexcept
 	{
 		Fs = _Fs;
-		switch (state)
+		riseCoeffs = makeCoeffs(rise);
+		fallCoeffs = makeCoeffs(fall);
+	}
+
+	void EnvFol::setTimes(float _riseInMs, float _fallInMs) noexcept
+	{
+		if (rise != _riseInMs)
 		{
-		case State::Rise: return smoothie.makeFromDecayInMs(rise, Fs);
-		case State::Fall: return smoothie.makeFromDecayInMs(fall, Fs);
+			rise = _riseInMs;
+			riseCoeffs = makeCoeffs(rise);
+		}
+		if (fall != _fallInMs)
+		{
+			fall = _fallInMs;
+			fallCoeffs = makeCoeffs(fall);
 		}
 	}
 
 	void EnvFol::operator()(float* buf, const float* smpls, int numSamples,
 		float _riseInMs, float _fallInMs) noexcept
 	{
+		setTimes(_riseInMs, _fallInMs);
+		operator()(buf, smpls, numSamples);
+	}
+
+	void EnvFol::operator()(float* buf, const float* smpls, int numSamples) noexcept
+	{
+		const auto r = riseCoeffs;
+		const auto f = fallCoeffs;
+		auto e = env;
+		auto isRising = rising;
+		// selects the coefficients by value, so that it compiles to a blend instead of a branch
 		for (auto s = 0; s < numSamples; ++s)
-			buf[s] = process(smpls[s], _riseInMs, _fallInMs);
+		{
+			const auto smpl = smpls[s];
+			isRising = (smpl > e) | (isRising & (smpl >= e));
+			const auto a0 = isRising ? r.a0 : f.a0;
+			const auto b1 = isRising ? r.b1 : f.b1;
+			e = smpl * a0 + e * b1;
+			buf[s] = e;
+		}
+		env = e;
+		rising = isRising;
 	}
 
 	float EnvFol::process(float smpl,
 		float _riseInMs, float _fallInMs) noexcept
 	{
-		rise = _riseInMs;
-		fall = _fallInMs;
+		setTimes(_riseInMs, _fallInMs);
+		return process(smpl);
+	}
 
-		switch (state)
+	float EnvFol::process(float smpl) noexcept
+	{
+		rising = smpl > env || (rising && smpl >= env);
+		const auto& c = rising ? riseCoeffs : fallCoeffs;
+		env = smpl * c.a0 + env * c.b1;
+		return env;
+	}
+
+	EnvFol::Coeffs EnvFol::makeCoeffs(float decayInMs) const noexcept
+	{
+		const auto x = std::exp(-1.f / (decayInMs * Fs * .001f));
+		return { 1.f - x, x };
+	}
+
+	// LevelDetector
+
+	LevelDetector::LevelDetector() :
+		phases(),
+		linear(),
+		interpolated(),
+		sumOfSquares(0.f),
+		peak(0.f),
+		blockSize(0),
+		numSamplesWindow(0),
+		mode(Mode::Peak)
+	{
+		// linear[History + s] is the latest sample at s, so every phase interpolates
+		// between the samples History / 2 and History / 2 + 1 before it
+		static constexpr float Pi = 3.14159265359f;
+		static constexpr float Cutoff = .9f;
+		static constexpr float HalfWidth = static_cast<float>(NumTaps / 2);
+
+		for (auto p = 0; p < NumPhases - 1; ++p)
 		{
-		case State::Rise: return processRise(smpl);
-		case State::Fall: return processFall(smpl);
-		default: return smpl;
+			auto& h = phases[p];
+			const auto frac = static_cast<float>(p + 1) / static_cast<float>(NumPhases);
+			auto sum = 0.f;
+			for (auto k = 0; k < NumTaps; ++k)
+			{
+				const auto t = static_cast<float>(NumTaps / 2 - 1 - k) + frac;
+				const auto x = Pi * Cutoff * t;
+				const auto sinc = x == 0.f ? 1.f : std::sin(x) / x;
+				const auto window = .5f + .5f * std::cos(Pi * t / HalfWidth);
+				h[k] = sinc * window;
+				sum += h[k];
+			}
+			for (auto& c : h)
+				c /= sum;
 		}
 	}
 
-	float EnvFol::processRise(float smpl) noexcept
+	void LevelDetector::prepare(int _blockSize, Mode _mode)
+	{
+		blockSize = _blockSize;
+		mode = _mode;
+		sumOfSquares = 0.f;
+		peak = 0.f;
+		numSamplesWindow = 0;
+
+		const auto tp = mode == Mode::TruePeak;
+		for (auto& l : linear)
+			l.assign(tp ? History + blockSize : 0, 0.f);
+		interpolated.resize(tp ? blockSize : 0);
+	}
+
+	void LevelDetector::operator()(const float* const* samples, int numChannels, int startIdx, int numSamples) noexcept
 	{
-		if (env > smpl)
+		numChannels = std::min(numChannels, MaxChannels);
+		numSamplesWindow += numSamples;
+
+		switch (mode)
 		{
-			state = State::Fall;
-			smoothie.makeFromDecayInMs(fall, Fs);
+		case Mode::RMS:
+			sumOfSquares += getSumOfSquares(samples[0] + startIdx,
+				numChannels == 1 ? nullptr : samples[1] + startIdx, numSamples);
+			return;
+		case Mode::Peak:
+			for (auto ch = 0; ch < numChannels; ++ch)
+				peak = std::max(peak, getPeak(samples[ch] + startIdx, numSamples));
+			return;
+		case Mode::TruePeak:
+			for (auto ch = 0; ch < numChannels; ++ch)
+			{
+				const auto smpls = samples[ch] + startIdx;
+				peak = std::max(peak, getPeak(smpls, numSamples));
+				for (auto s = 0; s < numSamples; s += blockSize)
+				{
+					const auto n = std::min(blockSize, numSamples - s);
+					peak = std::max(peak, getInterSamplePeak(ch, smpls + s, n));
+				}
+			}
+			return;
+		default:
+			return;
 		}
-		env = smoothie(smpl);
-		return env;
 	}
 
-	float EnvFol::processFall(float smpl) noexcept
+	float LevelDetector::flush(int numChannels) noexcept
 	{
-		if (env < smpl)
+		auto level = peak;
+		if (mode == Mode::RMS)
 		{
-			state = State::Rise;
-			smoothie.makeFromDecayInMs(rise, Fs);
+			const auto meanSquare = numSamplesWindow == 0 ? 0.f : sumOfSquares / static_cast<float>(numSamplesWindow);
+			level = std::sqrt(meanSquare) * (numChannels == 1 ? 1.f : .5f);
 		}
-		env = smoothie(smpl);
-		return env;
+
+		sumOfSquares = 0.f;
+		peak = 0.f;
+		numSamplesWindow = 0;
+		return level;
+	}
+
+	float LevelDetector::getPeak(const float* smpls, int numSamples) noexcept
+	{
+		if (numSamples <= 0)
+			return 0.f;
+		const auto range = juce::FloatVectorOperations::findMinAndMax(smpls, numSamples);
+		return std::max(-range.getStart(), range.getEnd());
+	}
+
+	float LevelDetector::getSumOfSquares(const float* left, const float* right, int numSamples) noexcept
+	{
+		// independent lanes, so that the compiler can keep them in one vector register
+		static constexpr int NumLanes = 8;
+		std::array<float, NumLanes> lanes;
+		lanes.fill(0.f);
+
+		auto s = 0;
+		if (right == nullptr)
+		{
+			for (; s + NumLanes <= numSamples; s += NumLanes)
+				for (auto i = 0; i < NumLanes; ++i)
+				{
+					const auto x = left[s + i];
+					lanes[i] += x * x;
+				}
+			for (; s < numSamples; ++s)
+				lanes[0] += left[s] * left[s];
+		}
+		else
+		{
+			for (; s + NumLanes <= numSamples; s += NumLanes)
+				for (auto i = 0; i < NumLanes; ++i)
+				{
+					const auto x = left[s + i] + right[s + i];
+					lanes[i] += x * x;
+				}
+			for (; s < numSamples; ++s)
+			{
+				const auto x = left[s] + right[s];
+				lanes[0] += x * x;
+			}
+		}
+
+		auto sum = 0.f;
+		for (const auto lane : lanes)
+			sum += lane;
+		return sum;
+	}
+
+	float LevelDetector::getInterSamplePeak(int ch, const float* smpls, int numSamples) noexcept
+	{
+		using SIMD = juce::FloatVectorOperations;
+
+		auto lin = linear[ch].data();
+		SIMD::copy(lin + History, smpls, numSamples);
+
+		auto maxPeak = 0.f;
+		const auto y = interpolated.data();
+		for (const auto& h : phases)
+		{
+			// one multiply-add over the whole block per tap
+			SIMD::multiply(y, lin, h[0], numSamples);
+			for (auto k = 1; k < NumTaps; ++k)
+				SIMD::addWithMultiply(y, lin + k, h[k], numSamples);
+			maxPeak = std::max(maxPeak, getPeak(y, numSamples));
+		}
+
+		std::memmove(lin, lin + numSamples, History * sizeof(float));
+		return maxPeak;
 	}
-	
-}
\ No newline at end of file
+}
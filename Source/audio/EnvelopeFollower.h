@@ -1,5 +1,6 @@
 #pragma once
-#include "../arch/Smooth.h"
+#include <array>
+#include <vector>
 
 namespace audio
 {
@@ -8,29 +9,86 @@ namespace audio
 	*/
 	struct EnvFol
 	{
-		enum class State { Rise, Fall, NumStates };
-
-		using Smoothie = smooth::Lowpass<float>;
-
 		EnvFol();
 
 		// Fs
 		void prepare(float) noexcept;
 
+		/* riseInMs, fallInMs
+		the coefficients are only recalculated if the times changed */
+		void setTimes(float, float) noexcept;
+
 		/* buf, smpls, numSamples, riseInMs, fallInMs */
 		void operator()(float*, const float*, int,
 			float, float) noexcept;
 
+		/* buf, smpls, numSamples */
+		void operator()(float*, const float*, int) noexcept;
+
 		/* smpl, riseInMs, fallInMs */
 		float process(float, float, float) noexcept;
 
+		/* smpl */
+		float process(float) noexcept;
+
 	protected:
-		Smoothie smoothie;
+		// one pole lowpass, y = x * a0 + y * b1
+		struct Coeffs
+		{
+			float a0, b1;
+		};
+
+		Coeffs riseCoeffs, fallCoeffs;
 		float rise, fall, env, Fs;
-		State state;
+		// an input equal to the envelope keeps the direction it had
+		bool rising;
+
+		/* decayInMs */
+		Coeffs makeCoeffs(float) const noexcept;
+	};
+
+	/*
+	* the level of a signal over a window of blocks, to feed an EnvFol at a lower rate
+	*/
+	struct LevelDetector
+	{
+		enum class Mode { Peak, RMS, TruePeak, NumModes };
+
+		static constexpr int MaxChannels = 2;
+
+		LevelDetector();
+
+		/* blockSize, mode */
+		void prepare(int, Mode);
+
+		/* samples, numChannels, startIdx, numSamples */
+		void operator()(const float* const*, int, int, int) noexcept;
+
+		/* numChannels, returns the level since the last flush and starts a new window */
+		float flush(int) noexcept;
+
+	protected:
+		// true peak: 4x oversampled with a windowed sinc, like ITU-R BS.1770.
+		// the even phase is the signal itself, so only the 3 fractional phases are computed.
+		static constexpr int NumPhases = 4;
+		static constexpr int NumTaps = 12;
+		static constexpr int History = NumTaps - 1;
+
+		std::array<std::array<float, NumTaps>, NumPhases - 1> phases;
+		// history followed by the block, per channel
+		std::array<std::vector<float>, MaxChannels> linear;
+		std::vector<float> interpolated;
+		float sumOfSquares, peak;
+		int blockSize, numSamplesWindow;
+		Mode mode;
+
+		/* smpls, numSamples */
+		static float getPeak(const float*, int) noexcept;
 
-		float processRise(float) noexcept;
+		/* left, right or nullptr, numSamples, of the mid signal */
+		static float getSumOfSquares(const float*, const float*, int) noexcept;
 
-		float processFall(float) noexcept;
+		/* ch, smpls, numSamples <= blockSize, the peak between the samples */
+		float getInterSamplePeak(int, const float*, int) noexcept;
 	};
-}
\ No newline at end of file
+}
@@ -2,6 +2,8 @@
 #include "MIDIManager.h"
 #include "../arch/Conversion.h"
 #include "PRM.h"
+#include "Skew.h"
+#include "StageCurve.h"
 
 namespace audio
 {
@@ -47,6 +49,7 @@ namespace audio
 			velocitySens(0.f),
 			atkP(0.f), dcyP(0.f), susP(0.f), rlsP(0.f),
 			atkShapeP(0.f), dcyShapeP(0.f), rlsShapeP(0.f),
+			atkCurve(), dcyCurve(), rlsCurve(),
 			lookahead(false),
 			note(),
 			noteIdx(0), noteOnCount(0), legatoSusIdx(0)
@@ -108,6 +111,16 @@ namespace audio
 			}
 		}
 
+		/* releases every held note */
+		void allNotesOff() noexcept
+		{
+			for (auto& n : note)
+				n.noteOn = false;
+			noteOnCount = 0;
+			if (state != State::Release)
+				triggerRelease();
+		}
+
 		void prepare(float Fs, int blockSize)
 		{
 			atkP.prepare(Fs, blockSize, 15.f);
@@ -162,14 +175,50 @@ namespace audio
 			return env;
 		}
 
+		/* samples, startIdx, endIdx
+		renders [startIdx, endIdx) without any note events in between.
+		each stage is rendered in its own loop until its end is reached,
+		only the transition samples go through process(s). */
+		void processBlock(float* samples, int s, int end) noexcept
+		{
+			while (s < end)
+			{
+				const auto noteOn = note[noteIdx].noteOn;
+				switch (state)
+				{
+				case State::Attack:
+					if (noteOn)
+						s = renderAttack(samples, s, end);
+					break;
+				case State::Decay:
+					if (noteOn)
+						s = renderDecay(samples, s, end);
+					break;
+				case State::Sustain:
+					if (noteOn)
+						s = renderSustain(samples, s, end);
+					break;
+				case State::Release:
+					if (!noteOn)
+						s = renderRelease(samples, s, end);
+					break;
+				}
+
+				if (s < end)
+				{
+					samples[s] = process(s);
+					++s;
+				}
+			}
+		}
+
 		void processBypassed(float* samples, int numSamples) noexcept
 		{
 			for (auto& n : note)
 				n.noteOn = false;
 			setNoteOff(24);
 
-			for (auto s = 0; s < numSamples; ++s)
-				samples[s] = process(s);
+			processBlock(samples, 0, numSamples);
 		}
 
 		State state;
@@ -178,7 +227,34 @@ namespace audio
 		float velocitySens;
 		PRM atkP, dcyP, susP, rlsP;
 		PRM atkShapeP, dcyShapeP, rlsShapeP;
+		// replace the skew of their stage while enabled
+		StageCurve atkCurve, dcyCurve, rlsCurve;
 		bool lookahead;
+
+		/* attack, decay or release, else nullptr */
+		StageCurve* getCurve(State s) noexcept
+		{
+			switch (s)
+			{
+			case State::Attack: return &atkCurve;
+			case State::Decay: return &dcyCurve;
+			case State::Release: return &rlsCurve;
+			default: return nullptr;
+			}
+		}
+
+		const StageCurve* getCurve(State s) const noexcept
+		{
+			return const_cast<EnvGen*>(this)->getCurve(s);
+		}
+
+		/* picks up curves that changed since the last block */
+		void updateCurves() noexcept
+		{
+			atkCurve.update();
+			dcyCurve.update();
+			rlsCurve.update();
+		}
 	protected:
 		std::array<Note, 128> note;
 		int noteIdx, noteOnCount, legatoSusIdx;
@@ -280,11 +356,107 @@ namespace audio
 			note[noteIdx].noteOn = true;
 		}
 		
+		// RENDER SEGMENTS
+		// each returns the index of the first sample it did not render.
+		// the raw ramp is written into samples first and then shaped in place.
+
+		int renderAttack(float* samples, int s, int end) noexcept
+		{
+			const auto atk = atkP.buf.data();
+			const auto bias = atkShapeP.buf.data();
+			auto raw = envRaw;
+			auto i = s;
+			for (; i < end; ++i)
+			{
+				const auto nRaw = raw + atk[i];
+				if (nRaw >= 1.f)
+					break;
+				raw = nRaw;
+				samples[i] = raw;
+			}
+			if (i == s)
+				return s;
+
+			const auto start = noteOnVal;
+			const auto range = note[noteIdx].gain - noteOnVal;
+			shape(atkCurve, samples + s, bias + s, i - s);
+			for (auto j = s; j < i; ++j)
+				samples[j] = start + range * samples[j];
+
+			envRaw = raw;
+			env = samples[i - 1];
+			return i;
+		}
+
+		int renderDecay(float* samples, int s, int end) noexcept
+		{
+			const auto dcy = dcyP.buf.data();
+			const auto sus = susP.buf.data();
+			const auto bias = dcyShapeP.buf.data();
+			auto raw = envRaw;
+			auto i = s;
+			for (; i < end; ++i)
+			{
+				const auto nRaw = raw + dcy[i];
+				if (nRaw >= 1.f)
+					break;
+				raw = nRaw;
+				samples[i] = raw;
+			}
+			if (i == s)
+				return s;
+
+			const auto veloGain = note[noteIdx].gain;
+			shape(dcyCurve, samples + s, bias + s, i - s);
+			for (auto j = s; j < i; ++j)
+			{
+				const auto susGain = sus[j] * veloGain;
+				samples[j] = veloGain - (veloGain - susGain) * samples[j];
+			}
+
+			envRaw = raw;
+			env = samples[i - 1];
+			return i;
+		}
+
+		int renderSustain(float* samples, int s, int end) noexcept
+		{
+			const auto sus = susP.buf.data();
+			const auto veloGain = note[noteIdx].gain;
+			for (auto i = s; i < end; ++i)
+				samples[i] = sus[i] * veloGain;
+
+			envRaw = sus[end - 1];
+			env = samples[end - 1];
+			return end;
+		}
+
+		int renderRelease(float* samples, int s, int end) noexcept
+		{
+			const auto rls = rlsP.buf.data();
+			const auto bias = rlsShapeP.buf.data();
+			auto raw = envRaw;
+			for (auto i = s; i < end; ++i)
+			{
+				raw = std::min(raw + rls[i], 1.f);
+				samples[i] = raw;
+			}
+
+			const auto offVal = noteOffVal;
+			shape(rlsCurve, samples + s, bias + s, end - s);
+			for (auto i = s; i < end; ++i)
+				samples[i] = offVal - samples[i] * offVal;
+
+			envRaw = raw;
+			env = samples[end - 1];
+			return end;
+		}
+
 		// SHAPE
 
 		void shapeAttack(int s) noexcept
 		{
-			env = noteOnVal + (note[noteIdx].gain - noteOnVal) * getSkewed(envRaw, atkShapeP[s]);
+			env = noteOnVal + (note[noteIdx].gain - noteOnVal) * shape(atkCurve, envRaw, atkShapeP[s]);
 		}
 
 		void shapeDecay(int s) noexcept
@@ -292,7 +464,7 @@ namespace audio
 			const auto veloGain = note[noteIdx].gain;
 			const auto sus = susP[s] * veloGain;
 			
-			env = veloGain - (veloGain - sus) * getSkewed(envRaw, dcyShapeP[s]);
+			env = veloGain - (veloGain - sus) * shape(dcyCurve, envRaw, dcyShapeP[s]);
 		}
 
 		void shapeSustain() noexcept
@@ -302,21 +474,292 @@ namespace audio
 
 		void shapeRelease(int s) noexcept
 		{
- 			env = noteOffVal - getSkewed(envRaw, rlsShapeP[s]) * noteOffVal;
+ 			env = noteOffVal - shape(rlsCurve, envRaw, rlsShapeP[s]) * noteOffVal;
+		}
+
+		/* curve, x, bias */
+		static float shape(const StageCurve& curve, float x, float bias) noexcept
+		{
+			return curve.isEnabled() ? curve(x) : getSkewed(x, bias);
+		}
+
+		/* curve, samples, bias, numSamples. shapes in place */
+		static void shape(const StageCurve& curve, float* samples, const float* bias, int numSamples) noexcept
+		{
+			if (curve.isEnabled())
+				curve(samples, samples, numSamples);
+			else
+				getSkewed(samples, samples, bias, numSamples);
 		}
 
 	public:
 		static float getSkewed(float x, float bias) noexcept
 		{
-			const auto b2 = bias + bias;
-			const auto bM = 1.f - bias;
-			const auto xy = bM - x + b2 * x;
-			if (xy == 0.f)
-				return 0.f;
-			return bias * x / xy;
+			return skew::getSkewed(x, bias);
+		}
+
+		/* dest, x, bias, numSamples */
+		static void getSkewed(float* dest, const float* x, const float* bias, int numSamples) noexcept
+		{
+			skew::getSkewed(dest, x, bias, numSamples);
 		}
 	};
 
+	// polyphonic counterpart of EnvGen. every voice has its own envelope,
+	// while all voices share the parameter buffers of an EnvGen.
+	// voice state is kept in structure-of-arrays layout, so that each sample
+	// advances all voices together in loops the compiler can vectorize.
+	struct EnvGenPoly
+	{
+		static constexpr int MaxVoices = 64;
+		static constexpr int NoNote = -1;
+
+		enum Stage { Attack, Decay, Sustain, Release };
+
+		EnvGenPoly() :
+			stage(), noteNum(),
+			raw(), env(), startVal(), gain(), bias(), skewed(),
+			age(),
+			buffer(),
+			numVoices(1), blockSize(0), ageCounter(0)
+		{
+			reset(0, MaxVoices);
+		}
+
+		void prepare(int _blockSize)
+		{
+			blockSize = _blockSize;
+			buffer.resize(MaxVoices * blockSize, 0.f);
+		}
+
+		/* numVoices [1, MaxVoices], voices beyond the count are reset */
+		void setNumVoices(int n) noexcept
+		{
+			n = juce::jlimit(1, MaxVoices, n);
+			if (n < numVoices)
+				reset(n, numVoices);
+			numVoices = n;
+		}
+
+		/* noteNumber, velocity, velocitySensitivity */
+		void setNoteOn(int note, float velo, float velocitySens) noexcept
+		{
+			if (velo < EnvGen::MinVelocity)
+				return setNoteOff(note);
+
+			const auto v = findVoice(note);
+			startVal[v] = env[v];
+			raw[v] = 0.f;
+			stage[v] = Attack;
+			noteNum[v] = note;
+			gain[v] = 1.f + velocitySens * (velo - 1.f);
+			age[v] = ++ageCounter;
+		}
+
+		void setNoteOff(int note) noexcept
+		{
+			for (auto v = 0; v < numVoices; ++v)
+				if (noteNum[v] == note)
+					triggerRelease(v);
+		}
+
+		void allNotesOff() noexcept
+		{
+			for (auto v = 0; v < numVoices; ++v)
+				if (noteNum[v] != NoNote)
+					triggerRelease(v);
+		}
+
+		/* silences all voices immediately */
+		void reset() noexcept
+		{
+			reset(0, MaxVoices);
+		}
+
+		/* parameters, startIdx, endIdx */
+		void processBlock(const EnvGen& prms, int s, int end) noexcept
+		{
+			const auto atkBuf = prms.atkP.buf.data();
+			const auto dcyBuf = prms.dcyP.buf.data();
+			const auto susBuf = prms.susP.buf.data();
+			const auto rlsBuf = prms.rlsP.buf.data();
+			const auto atkShapeBuf = prms.atkShapeP.buf.data();
+			const auto dcyShapeBuf = prms.dcyShapeP.buf.data();
+			const auto rlsShapeBuf = prms.rlsShapeP.buf.data();
+			const auto hasCurve = prms.atkCurve.isEnabled() || prms.dcyCurve.isEnabled() || prms.rlsCurve.isEnabled();
+
+			for (; s < end; ++s)
+			{
+				const auto atk = atkBuf[s];
+				const auto dcy = dcyBuf[s];
+				const auto sus = susBuf[s];
+				const auto rls = rlsBuf[s];
+				const auto atkShape = atkShapeBuf[s];
+				const auto dcyShape = dcyShapeBuf[s];
+				const auto rlsShape = rlsShapeBuf[s];
+
+				// synthesize, same transitions as EnvGen's state machine
+				for (auto v = 0; v < numVoices; ++v)
+				{
+					auto st = stage[v];
+					auto r = raw[v];
+
+					r += st == Attack ? atk : st == Decay ? dcy : st == Release ? rls : 0.f;
+
+					const auto atkDone = st == Attack && r >= 1.f;
+					r = atkDone ? dcy : r;
+					st = atkDone ? Decay : st;
+
+					const auto dcyDone = st == Decay && r >= 1.f;
+					st = dcyDone ? Sustain : st;
+
+					r = st == Sustain ? sus : st == Release ? std::min(r, 1.f) : r;
+
+					stage[v] = st;
+					raw[v] = r;
+					bias[v] = st == Attack ? atkShape : st == Decay ? dcyShape : rlsShape;
+				}
+
+				skew::getSkewed(skewed.data(), raw.data(), bias.data(), numVoices);
+				if (hasCurve)
+					for (auto v = 0; v < numVoices; ++v)
+					{
+						const auto curve = prms.getCurve(static_cast<EnvGen::State>(stage[v]));
+						if (curve != nullptr && curve->isEnabled())
+							skewed[v] = (*curve)(raw[v]);
+					}
+
+				// shape
+				for (auto v = 0; v < numVoices; ++v)
+				{
+					const auto st = stage[v];
+					const auto sk = skewed[v];
+					const auto g = gain[v];
+					const auto a = startVal[v];
+
+					env[v] =
+						st == Attack ? a + (g - a) * sk :
+						st == Decay ? g - (g - sus * g) * sk :
+						st == Sustain ? raw[v] * g :
+						a - sk * a;
+				}
+
+				for (auto v = 0; v < numVoices; ++v)
+					buffer[v * blockSize + s] = env[v];
+			}
+		}
+
+		/* dest, firstVoice, voiceStride, numSamples
+		writes the maximum of the voices firstVoice, firstVoice + voiceStride, ... */
+		void getMax(float* dest, int firstVoice, int stride, int numSamples) const noexcept
+		{
+			if (firstVoice >= numVoices)
+			{
+				SIMD::fill(dest, 0.f, numSamples);
+				return;
+			}
+
+			SIMD::copy(dest, data(firstVoice), numSamples);
+			for (auto v = firstVoice + stride; v < numVoices; v += stride)
+				SIMD::max(dest, dest, data(v), numSamples);
+		}
+
+		const float* data(int v) const noexcept
+		{
+			return buffer.data() + v * blockSize;
+		}
+
+		float* data(int v) noexcept
+		{
+			return buffer.data() + v * blockSize;
+		}
+
+		int getNumVoices() const noexcept
+		{
+			return numVoices;
+		}
+
+	protected:
+		alignas(32) std::array<int, MaxVoices> stage, noteNum;
+		alignas(32) std::array<float, MaxVoices> raw, env, startVal, gain, bias, skewed;
+		std::array<juce::uint32, MaxVoices> age;
+		std::vector<float> buffer;
+		int numVoices, blockSize;
+		juce::uint32 ageCounter;
+
+		void triggerRelease(int v) noexcept
+		{
+			startVal[v] = env[v];
+			raw[v] = 0.f;
+			stage[v] = Release;
+			noteNum[v] = NoNote;
+		}
+
+		/* first, end */
+		void reset(int v0, int v1) noexcept
+		{
+			for (auto v = v0; v < v1; ++v)
+			{
+				stage[v] = Release;
+				noteNum[v] = NoNote;
+				raw[v] = 1.f;
+				env[v] = startVal[v] = 0.f;
+				gain[v] = 1.f;
+				bias[v] = skewed[v] = 0.f;
+				age[v] = 0;
+			}
+		}
+
+		/* retriggers a voice that already plays the note, else takes the
+		released voice with the oldest note, else steals the oldest playing one */
+		int findVoice(int note) const noexcept
+		{
+			for (auto v = 0; v < numVoices; ++v)
+				if (noteNum[v] == note)
+					return v;
+
+			auto released = -1, oldest = 0;
+			for (auto v = 0; v < numVoices; ++v)
+			{
+				if (noteNum[v] == NoNote)
+				{
+					if (released == -1 || age[v] < age[released])
+						released = v;
+				}
+				else if (age[v] < age[oldest])
+					oldest = v;
+			}
+
+			return released != -1 ? released : oldest;
+		}
+	};
+
+	// per sample parameter values of a block with automation, in the parameters' own units.
+	// nullptr means not automated in this block.
+	struct EnvGenAutomation
+	{
+		enum
+		{
+			Atk, Dcy, Sus, Rls,
+			AtkShape, DcyShape, RlsShape,
+			AtkBeats, DcyBeats, RlsBeats,
+			NumParams
+		};
+
+		EnvGenAutomation() :
+			ramps()
+		{
+			ramps.fill(nullptr);
+		}
+
+		const float* operator[](int i) const noexcept
+		{
+			return ramps[i];
+		}
+
+		std::array<const float*, NumParams> ramps;
+	};
+
 	struct EnvGenMIDI
 	{
 		static constexpr float MaxLatencyMs = EnvGen::MaxLatencyMs;
@@ -325,7 +768,10 @@ namespace audio
 			buffer(),
 			maxLatencySamples(0.f),
 			envGen(),
-			Fs(1.f)
+			poly(),
+			automationBuf(),
+			Fs(1.f),
+			inverse(false)
 		{
 		}
 
@@ -333,117 +779,142 @@ namespace audio
 		{
 			Fs = _Fs;
 			envGen.prepare(Fs, blockSize);
+			poly.prepare(blockSize);
 			buffer.resize(blockSize);
+			automationBuf.resize(blockSize);
 			maxLatencySamples = msInSamples(MaxLatencyMs, Fs);
 		}
 		
 		/* midiBuffer, numSamples, atk [0, N]ms, dcy [0, N]ms, sus [0, 1], rls [0, N]ms,
-		attackShape [-1,1], decayShape [-1,1], releaseShape [-1,1], legato [0, 2], inverse [0, 1],
+		attackShape [-1,1], decayShape [-1,1], releaseShape [-1,1], legato [0, 2],
+		numVoices [1, 64] (1 = monophonic with legato), inverse [0, 1],
 		velocitySensitivity [0, 1], tempoSync[0, 1],
-		atkBeats [0, N]beats, dcyBeats[0, N], rlsBeats[0, N] */
+		atkBeats [0, N]beats, dcyBeats[0, N], rlsBeats[0, N], playHead,
+		automation: parameters with automation in this block are taken sample by sample
+		from their ramps instead of being smoothed towards the block's value */
 		void operator()(MIDIBuffer& midi, int numSamples,
 			float _atk, float _dcy, float _sus, float _rls,
 			float _atkShape, float _dcyShape, float _rlsShape,
-			int _legato, bool _inverse, float _velo, bool _tempoSync,
+			int _legato, int _numVoices, bool _inverse, float _velo, bool _tempoSync,
 			float _atkBeats, float _dcyBeats, float _rlsBeats,
-			const PlayHeadPos& playHead) noexcept
+			const PlayHeadPos& playHead, const EnvGenAutomation& automation = EnvGenAutomation()) noexcept
 		{
+			using A = EnvGenAutomation;
+
+			inverse = _inverse;
+
+			envGen.updateCurves();
+
 			if (_tempoSync && playHead.bpm != 0.)
 			{
 				const auto beatsPerMinute = static_cast<float>(playHead.bpm);
 				const auto beatsPerSec = beatsPerMinute * .0166666667f;
 				const auto samplesPerBeat = 4.f * Fs / beatsPerSec;
-				
-				if (_atkBeats == 0.f)
-					envGen.atkP(1.1f, numSamples);
-				else
+				const auto beatsInInc = [samplesPerBeat](float beats)
 				{
-					_atk = _atkBeats * samplesPerBeat;
-					envGen.atkP(1.f / _atk, numSamples);
-				}
+					return beats == 0.f ? 1.1f : 1.f / (beats * samplesPerBeat);
+				};
 
-				if (_dcyBeats == 0.f)
-					envGen.dcyP(1.1f, numSamples);
-				else
-				{
-					_dcy = _dcyBeats * samplesPerBeat;
-					envGen.dcyP(1.f / _dcy, numSamples);
-				}
-
-				if (_rlsBeats == 0.f)
-					envGen.rlsP(1.1f, numSamples);
-				else
-				{
-					_rls = _rlsBeats * samplesPerBeat;
-					envGen.rlsP(1.f / _rls, numSamples);
-				}
+				automate(envGen.atkP, automation[A::AtkBeats], _atkBeats, numSamples, beatsInInc);
+				automate(envGen.dcyP, automation[A::DcyBeats], _dcyBeats, numSamples, beatsInInc);
+				automate(envGen.rlsP, automation[A::RlsBeats], _rlsBeats, numSamples, beatsInInc);
 			}
 			else
 			{
-				if (_atk == 0.f)
-					envGen.atkP(1.1f, numSamples);
-				else
-					envGen.atkP(msInInc(_atk, Fs), numSamples);
-				if (_dcy == 0.f)
-					envGen.dcyP(1.1f, numSamples);
-				else
-					envGen.dcyP(msInInc(_dcy, Fs), numSamples);
-				if (_rls == 0.f)
-					envGen.rlsP(1.1f, numSamples);
-				else
-					envGen.rlsP(msInInc(_rls, Fs), numSamples);
+				const auto fs = Fs;
+				const auto msToInc = [fs](float ms)
+				{
+					return ms == 0.f ? 1.1f : msInInc(ms, fs);
+				};
+
+				automate(envGen.atkP, automation[A::Atk], _atk, numSamples, msToInc);
+				automate(envGen.dcyP, automation[A::Dcy], _dcy, numSamples, msToInc);
+				automate(envGen.rlsP, automation[A::Rls], _rls, numSamples, msToInc);
 			}
 
-			envGen.susP(_sus, numSamples);
+			automate(envGen.susP, automation[A::Sus], _sus, numSamples, [](float x) { return x; });
 
-			envGen.atkShapeP(std::tanh(Pi * _atkShape) * .5f + .5f, numSamples);
-			envGen.dcyShapeP(-std::tanh(Pi * _dcyShape) * .5f + .5f, numSamples);
-			envGen.rlsShapeP(-std::tanh(Pi * _rlsShape) * .5f + .5f, numSamples);
+			const auto atkShapeToBias = [](float x) { return std::tanh(Pi * x) * .5f + .5f; };
+			const auto shapeToBias = [](float x) { return -std::tanh(Pi * x) * .5f + .5f; };
+			automate(envGen.atkShapeP, automation[A::AtkShape], _atkShape, numSamples, atkShapeToBias);
+			automate(envGen.dcyShapeP, automation[A::DcyShape], _dcyShape, numSamples, shapeToBias);
+			automate(envGen.rlsShapeP, automation[A::RlsShape], _rlsShape, numSamples, shapeToBias);
 			
-			if (midi.isEmpty())
+			// the engine that is switched off gets no more note offs, so it must not keep any notes.
+			// the poly voices aren't rendered in mono mode, so they can't finish a release and are reset.
+			const auto wasPolyphonic = isPoly();
+			poly.setNumVoices(_numVoices);
+			const auto polyphonic = isPoly();
+			if (polyphonic != wasPolyphonic)
 			{
-				for (auto s = 0; s < numSamples; ++s)
-					buffer[s] = envGen(s);
+				if (polyphonic)
+					envGen.allNotesOff();
+				else
+					poly.reset();
 			}
+
+			auto samples = buffer.data();
+			if (midi.isEmpty())
+				processBlock(samples, 0, numSamples, polyphonic);
 			else
 			{
 				envGen.legato = static_cast<EnvGen::LegatoMode>(_legato);
 				envGen.velocitySens = _velo;
 
-				auto evt = midi.begin();
-				auto ref = *evt;
-				auto ts = ref.samplePosition;
-
-				for (auto s = 0; s < numSamples; ++s)
+				// the block is split at the events' timestamps
+				auto s = 0;
+				for (const auto ref : midi)
 				{
-					while (s == ts)
+					const auto ts = ref.samplePosition;
+					if (ts >= numSamples)
+						break;
+					if (ts > s)
 					{
-						const auto msg = ref.getMessage();
-						if (msg.isNoteOnOrOff())
+						processBlock(samples, s, ts, polyphonic);
+						s = ts;
+					}
+
+					const auto msg = ref.getMessage();
+					if (msg.isNoteOnOrOff())
+					{
+						auto noteOn = msg.isNoteOn();
+						auto noteNum = msg.getNoteNumber();
+
+						if (polyphonic)
 						{
-							auto noteOn = msg.isNoteOn();
-							auto noteNum = msg.getNoteNumber();
-							
 							if (noteOn)
-								envGen.setNoteOn(noteNum, msg.getFloatVelocity());
+								poly.setNoteOn(noteNum, msg.getFloatVelocity(), _velo);
 							else
-								envGen.setNoteOff(noteNum);
+								poly.setNoteOff(noteNum);
 						}
-
-						++evt;
-						if (evt == midi.end())
-							break;
-						ref = *evt;
-						ts = ref.samplePosition;
+						else if (noteOn)
+							envGen.setNoteOn(noteNum, msg.getFloatVelocity());
+						else
+							envGen.setNoteOff(noteNum);
 					}
-
-					buffer[s] = envGen(s);
 				}
+				processBlock(samples, s, numSamples, polyphonic);
 			}
-			
-			if(_inverse)
-				for (auto s = 0; s < numSamples; ++s)
-					buffer[s] = 1.f - buffer[s];
+
+			// the voices stay as they are. idle voices are at 0, so only their maximum may be inverted
+			if (polyphonic)
+				poly.getMax(samples, 0, 1, numSamples);
+			if (_inverse)
+				invert(samples, numSamples);
+		}
+
+		/* true if the last block was inverted. the poly voices never are, see invert */
+		bool isInverse() const noexcept
+		{
+			return inverse;
+		}
+
+		/* samples, numSamples
+		inverts the combination of voices, never the voices themselves: 1 - max(voices) */
+		static void invert(float* samples, int numSamples) noexcept
+		{
+			for (auto s = 0; s < numSamples; ++s)
+				samples[s] = 1.f - samples[s];
 		}
 
 		float getAttackLength(int sampleIdx) noexcept
@@ -454,7 +925,28 @@ namespace audio
 		
 		void processBypassed(int numSamples) noexcept
 		{
+			envGen.updateCurves();
 			envGen.processBypassed(buffer.data(), numSamples);
+			if (isPoly())
+			{
+				poly.allNotesOff();
+				poly.processBlock(envGen, 0, numSamples);
+			}
+		}
+
+		bool isPoly() const noexcept
+		{
+			return poly.getNumVoices() > 1;
+		}
+
+		const EnvGenPoly& getPoly() const noexcept
+		{
+			return poly;
+		}
+
+		EnvGenPoly& getPoly() noexcept
+		{
+			return poly;
 		}
 
 		float operator[](int s) const noexcept
@@ -477,11 +969,60 @@ namespace audio
 			return EnvGen::getSkewed(x, bias);
 		}
 
+		/* attack, decay or release, else nullptr. set curves on the message thread only */
+		StageCurve* getCurve(EnvGen::State s) noexcept
+		{
+			return envGen.getCurve(s);
+		}
+
+		void savePatch(State& state) const
+		{
+			envGen.atkCurve.savePatch(state, "envgen/curves/attack");
+			envGen.dcyCurve.savePatch(state, "envgen/curves/decay");
+			envGen.rlsCurve.savePatch(state, "envgen/curves/release");
+		}
+
+		void loadPatch(const State& state)
+		{
+			envGen.atkCurve.loadPatch(state, "envgen/curves/attack");
+			envGen.dcyCurve.loadPatch(state, "envgen/curves/decay");
+			envGen.rlsCurve.loadPatch(state, "envgen/curves/release");
+		}
+
 		std::vector<float> buffer;
 		float maxLatencySamples;
 	protected:
 		EnvGen envGen;
+		EnvGenPoly poly;
+		std::vector<float> automationBuf;
 		float Fs;
+		bool inverse;
+
+		/* prm, ramp, val, numSamples, convert
+		smooths towards convert(val), or takes convert(ramp[s]) per sample if automated */
+		template<typename Convert>
+		void automate(PRM& prm, const float* ramp, float val, int numSamples, const Convert& convert) noexcept
+		{
+			if (ramp == nullptr)
+			{
+				prm(convert(val), numSamples);
+				return;
+			}
+
+			auto buf = automationBuf.data();
+			for (auto s = 0; s < numSamples; ++s)
+				buf[s] = convert(ramp[s]);
+			prm(buf, numSamples);
+		}
+
+		/* samples, startIdx, endIdx, polyphonic */
+		void processBlock(float* samples, int s, int end, bool polyphonic) noexcept
+		{
+			if (polyphonic)
+				poly.processBlock(envGen, s, end);
+			else
+				envGen.processBlock(samples, s, end);
+		}
 	};
 }
 
@@ -14,74 +14,92 @@ namespace audio
 {
 	LatencyCompensation::LatencyCompensation() :
 		ring(),
-		wHead(),
+		fadeBuf(),
+		maxLatency(0),
+		prevLatency(0),
+		fadeLength(0),
+		fadeIdx(0),
 		latency(0)
 	{}
 
 	void LatencyCompensation::prepare(int blockSize, int _latency)
 	{
-		latency = _latency;
-		if (latency != 0)
+		prepare(blockSize, _latency, _latency, 0);
+	}
+
+	void LatencyCompensation::prepare(int blockSize, int _latency, int _maxLatency, int _fadeLength)
+	{
+		latency = prevLatency = _latency;
+		fadeLength = _fadeLength;
+		fadeIdx = fadeLength;
+		maxLatency = std::max(_maxLatency, latency);
+		if (maxLatency != 0)
 		{
-			ring.setSize(2, latency, false, true, false);
-			wHead.prepare(blockSize, latency);
+			// the block is written before it's read, so the ring holds both
+			ring.prepare(2, maxLatency + blockSize);
+			fadeBuf.resize(blockSize);
 		}
 		else
 		{
-			ring.setSize(0, 0);
-			wHead.prepare(0, 0);
+			ring.prepare(0, 0);
+			fadeBuf.clear();
 		}
 	}
 
+	void LatencyCompensation::setLatency(int _latency) noexcept
+	{
+		_latency = juce::jlimit(0, maxLatency, _latency);
+		if (latency == _latency)
+			return;
+		prevLatency = latency;
+		latency = _latency;
+		fadeIdx = 0;
+	}
+
+	void LatencyCompensation::read(int ch, float* dest, int l, int numSamples) const noexcept
+	{
+		// a latency of l delays by l - 1 samples, like a ring of l samples that is written before it's read
+		const auto delay = std::max(l - 1, 0);
+		ring.read(ch, dest, numSamples + delay, numSamples);
+	}
+
 	void LatencyCompensation::operator()(float* const* dry, float* const* inputSamples, int numChannels, int numSamples) noexcept
 	{
-		if (latency != 0)
+		if (maxLatency == 0)
 		{
-			wHead(numSamples);
-
 			for (auto ch = 0; ch < numChannels; ++ch)
-			{
-				const auto smpls = inputSamples[ch];
+				SIMD::copy(dry[ch], inputSamples[ch], numSamples);
+			return;
+		}
 
-				auto rng = ring.getWritePointer(ch);
-				auto dr = dry[ch];
+		ring.write(inputSamples, numChannels, numSamples);
 
-				for (auto s = 0; s < numSamples; ++s)
-				{
-					const auto w = wHead[s];
-					const auto r = (w + 1) % latency;
+		const auto numFade = std::min(fadeLength - fadeIdx, numSamples);
+		for (auto ch = 0; ch < numChannels; ++ch)
+		{
+			auto dr = dry[ch];
+			read(ch, dr, latency, numSamples);
+			if (numFade <= 0)
+				continue;
 
-					rng[w] = smpls[s];
-					dr[s] = rng[r];
-				}
+			auto prev = fadeBuf.data();
+			read(ch, prev, prevLatency, numSamples);
+			const auto fadeLenInv = 1.f / static_cast<float>(fadeLength);
+			for (auto s = 0; s < numFade; ++s)
+			{
+				const auto fade = static_cast<float>(fadeIdx + s) * fadeLenInv;
+				dr[s] = prev[s] + fade * (dr[s] - prev[s]);
 			}
 		}
-		else
-			for (auto ch = 0; ch < numChannels; ++ch)
-				SIMD::copy(dry[ch], inputSamples[ch], numSamples);
+		if (numFade > 0)
+			fadeIdx += numFade;
 	}
 
 	void LatencyCompensation::operator()(float* const* samples, int numChannels, int numSamples) noexcept
 	{
-		if (latency != 0)
-		{
-			wHead(numSamples);
+		if (maxLatency == 0)
+			return;
 
-			for (auto ch = 0; ch < numChannels; ++ch)
-			{
-				const auto smpls = samples[ch];
-				auto rng = ring.getWritePointer(ch);
-
-				for (auto s = 0; s < numSamples; ++s)
-				{
-					const auto w = wHead[s];
-					const auto r = (w + 1) % latency;
-
-					rng[w] = smpls[s];
-					smpls[s] = rng[r];
-				}
-			}
-		}
+		operator()(samples, samples, numChannels, numSamples);
 	}
-	
-}
\ No newline at end of file
+}
@@ -1,6 +1,6 @@
 #pragma once
 #include "AudioUtils.h"
-#include "WHead.h"
+#include "RingBuffer.h"
 
 namespace audio
 {
@@ -11,6 +11,15 @@ namespace audio
 		/* blockSize, latency */
 		void prepare(int, int);
 
+		/* blockSize, latency, maxLatency, fadeLength
+		the ring is allocated for maxLatency, so that the latency can change
+		on the audio thread without allocating. */
+		void prepare(int, int, int, int);
+
+		/* latency [0, maxLatency]
+		moves the read head with a crossfade of fadeLength samples, realtime safe */
+		void setLatency(int) noexcept;
+
 		/* dry, inputSamples, numChannels, numSamples */
 		void operator()(float* const*, float* const*, int, int) noexcept;
 
@@ -18,8 +27,14 @@ namespace audio
 		void operator()(float* const*, int, int) noexcept;
 
 	protected:
-		AudioBuffer ring;
-		WHead wHead;
+		RingBuffer ring;
+		// the previous read tap while crossfading
+		std::vector<float> fadeBuf;
+		int maxLatency, prevLatency, fadeLength, fadeIdx;
+
+		/* ch, dest, latency, numSamples
+		reads the delayed block that was just written */
+		void read(int, float*, int, int) const noexcept;
 	public:
 		int latency;
 	};
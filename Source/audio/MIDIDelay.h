@@ -3,29 +3,71 @@
 
 namespace audio
 {
+    // delays midi events by a variable time.
+    // pending events are kept in a min-heap ordered by due time, so that a block only costs
+    // O(log n) per inserted and emitted event, no matter how many events are pending.
+    // the storage is allocated once, events that don't fit anymore are counted and dropped.
     class MIDIDelay
 	{
-        static constexpr int NumEvents = 64;
+        static constexpr int DefaultCapacity = 1024;
 
-        struct Evt
+        struct Key
         {
-            Evt() :
-				msg(MIDIMessage::noteOn(1, 0, 0.f)),
-                time(0),
-				used(false)
-            {}
-
-            MIDIMessage msg;
-            int time;
-            bool used;
+            juce::int64 time;
+            juce::uint32 seq;
+            int slot;
+        };
+
+        // earlier events first, same time keeps the order of arrival
+        struct Later
+        {
+            bool operator()(const Key& a, const Key& b) const noexcept
+            {
+                return a.time != b.time ? a.time > b.time : a.seq > b.seq;
+            }
         };
 
     public:
-		MIDIDelay() :
-            evts(),
-            outputBuffer()
+        /* capacity */
+		MIDIDelay(int capacity = DefaultCapacity) :
+            heap(),
+            msgs(),
+            freeSlots(),
+            outputBuffer(),
+            now(0),
+            seq(0),
+            numOverflows(0)
 		{
-            outputBuffer.ensureSize(NumEvents);
+            setCapacity(capacity);
+        }
+
+        /* capacity, not realtime safe. drops the pending events */
+        void setCapacity(int capacity)
+        {
+            capacity = std::max(1, capacity);
+            heap.clear();
+            heap.reserve(capacity);
+            msgs.assign(capacity, MIDIMessage::noteOn(1, 0, 0.f));
+            freeSlots.resize(capacity);
+            for (auto i = 0; i < capacity; ++i)
+                freeSlots[i] = capacity - 1 - i;
+            outputBuffer.ensureSize(static_cast<size_t>(capacity) * 16);
+        }
+
+        int getCapacity() const noexcept
+        {
+            return static_cast<int>(msgs.size());
+        }
+
+        int getNumPending() const noexcept
+        {
+            return static_cast<int>(heap.size());
+        }
+
+        /* events dropped because the delay was full */
+        int getNumOverflows() const noexcept
+        {
+            return numOverflows.load();
         }
 
         void operator()(MIDIBuffer& midi, int numSamples, int delayTimeSamples) noexcept
@@ -33,59 +75,76 @@ namespace audio
             if (delayTimeSamples < 1)
                 return;
 
+            // an event is due delayTimeSamples - 1 samples after its position
+            const auto offset = now + delayTimeSamples - 1;
             for (auto itRef : midi)
-            {
-                auto msg = itRef.getMessage();
-                midiToEvts(msg, itRef.samplePosition + delayTimeSamples);
-            }
+                push(itRef.getMessage(), offset + itRef.samplePosition);
 
             outputBuffer.clear();
 
-            for (auto s = 0; s < numSamples; ++s)
-                evtsToOutput(s);
-            
+            const auto end = now + numSamples;
+            while (!heap.empty() && heap.front().time < end)
+            {
+                const auto key = heap.front();
+                std::pop_heap(heap.begin(), heap.end(), Later());
+                heap.pop_back();
+
+                const auto s = static_cast<int>(std::max(key.time - now, juce::int64(0)));
+                outputBuffer.addEvent(msgs[key.slot], s);
+                freeSlots.push_back(key.slot);
+            }
+            now = end;
+
             midi.swapWith(outputBuffer);
 		}
 
-    protected:
-		std::array<Evt, NumEvents> evts;
-        MIDIBuffer outputBuffer;
-
-        void midiToEvts(MIDIMessage& msg, int time) noexcept
+        /* midi
+        emits all pending events at the start of the block, before its own events.
+        for when the delay is switched off, so that no note-off gets lost */
+        void flush(MIDIBuffer& midi) noexcept
         {
-            for (auto i = 0; i < NumEvents; ++i)
+            if (heap.empty())
+                return;
+
+            outputBuffer.clear();
+            while (!heap.empty())
             {
-                auto& evt = evts[i];
-
-                if (!evt.used)
-                {
-                    evt.time = time;
-                    evt.msg = msg;
-                    evt.used = true;
-                    return;
-                }
+                const auto key = heap.front();
+                std::pop_heap(heap.begin(), heap.end(), Later());
+                heap.pop_back();
+
+                outputBuffer.addEvent(msgs[key.slot], 0);
+                freeSlots.push_back(key.slot);
             }
+            outputBuffer.addEvents(midi, 0, -1, 0);
+
+            midi.swapWith(outputBuffer);
         }
 
-        void evtsToOutput(int s) noexcept
+    protected:
+        std::vector<Key> heap;
+        std::vector<MIDIMessage> msgs;
+        std::vector<int> freeSlots;
+        MIDIBuffer outputBuffer;
+        juce::int64 now;
+        juce::uint32 seq;
+        std::atomic<int> numOverflows;
+
+        /* msg, time */
+        void push(const MIDIMessage& msg, juce::int64 time) noexcept
         {
-            for (auto i = 0; i < NumEvents; ++i)
+            if (freeSlots.empty())
             {
-                auto& evt = evts[i];
-
-                if (evt.used)
-                {
-                    --evt.time;
-                    if (evt.time < 1)
-                    {
-                        if (outputBuffer.addEvent(evt.msg, s))
-                        {
-                            evt.used = false;
-                        }
-                    }
-                }
+                numOverflows.store(numOverflows.load() + 1);
+                return;
             }
-                
+
+            const auto slot = freeSlots.back();
+            freeSlots.pop_back();
+            msgs[slot] = msg;
+
+            heap.push_back({ time, seq++, slot });
+            std::push_heap(heap.begin(), heap.end(), Later());
         }
 	};
 }
@@ -96,4 +155,4 @@ to do:
 
 if lookahead enabled, gui needs to show if attack parameter longer than possible latency
 
-*/
\ No newline at end of file
+*/
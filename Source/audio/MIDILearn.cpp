@@ -2,83 +2,229 @@
 
 namespace audio
 {
-	MIDILearn::CC::CC() :
-		param(nullptr)
-	{}
+	// TABLE
 
-	void MIDILearn::CC::setValue(int _value)
+	int MIDILearn::Table::getNRPNSlot(int number) const noexcept
 	{
-		auto p = param.load();
-		if (p == nullptr)
-			return;
-
-		const auto value = static_cast<float>(_value) * ValInv;
-
-		p->setValueWithGesture(value);
+		const auto it = std::lower_bound(nrpnNumbers.begin(), nrpnNumbers.end(), number);
+		if (it == nrpnNumbers.end() || *it != number)
+			return -1;
+		return NumCC + NumCC14 + static_cast<int>(it - nrpnNumbers.begin());
 	}
 
+	// MIDILEARN
+
 	MIDILearn::MIDILearn(Params& _params, State& _state) :
-		ccBuf(),
 		ccIdx(-1),
 		assignableParam(nullptr),
 		params(_params),
 		state(_state),
-		c(-1)
+		mappingsLock(),
+		mappings(),
+		tables(),
+		backIdx(0),
+		middleIdx(1),
+		frontIdx(2),
+		decoders(),
+		smoothers(),
+		changes(),
+		learned(),
+		pendingValues(),
+		pending(),
+		learnedMSBParam(nullptr),
+		Fs(1.f),
+		c(-1),
+		learnedMSB(-1)
 	{
+		for (auto& decoder : decoders)
+		{
+			decoder.msb.fill(0);
+			decoder.nrpn = -1;
+			decoder.dataMSB = 0;
+			decoder.dataLSB = 0;
+		}
+		for (auto& s : smoothers)
+			s = { -1, 0.f, 0.f, 0.f, false };
+		pending.fill(false);
+		for (auto& table : tables)
+			table.offsets.assign(NumCC + NumCC14 + 1, 0);
+		startTimerHz(DrainFPS);
+	}
+
+	MIDILearn::~MIDILearn()
+	{
+		stopTimer();
+	}
+
+	void MIDILearn::prepare(float _Fs)
+	{
+		Fs = _Fs;
 	}
 
 	void MIDILearn::savePatch() const
 	{
-		for (auto i = 0; i < ccBuf.size(); ++i)
+		const juce::ScopedLock lock(mappingsLock);
+		const auto numMappings = static_cast<int>(mappings.size());
+		state.set("midilearn/mappings", "num", numMappings, true);
+		for (auto i = 0; i < numMappings; ++i)
 		{
-			const auto& cc = ccBuf[i];
-			const auto prm = cc.param.load();
-			if (prm != nullptr)
-				state.set(getIDString(i), "id", param::toID(param::toString(prm->id)), true);
+			const auto& m = mappings[i];
+			const auto idStr = getIDString(i);
+			state.set(idStr, "source", static_cast<int>(m.source), true);
+			state.set(idStr, "number", m.number, true);
+			state.set(idStr, "id", param::toID(param::toString(m.pID)), true);
+			state.set(idStr, "min", m.min, true);
+			state.set(idStr, "max", m.max, true);
+			state.set(idStr, "curve", m.curve, true);
+			state.set(idStr, "smooth", m.smoothMs, true);
 		}
 	}
 
 	void MIDILearn::loadPatch()
 	{
-		for (auto i = 0; i < ccBuf.size(); ++i)
+		std::vector<Mapping> nMappings;
+
+		const auto num = state.get("midilearn/mappings", "num");
+		if (num == nullptr)
 		{
-			const auto var = state.get(getIDString(i), "id");
-			if (var)
+			// patches before the mapping table had one param per cc
+			for (auto i = 0; i < NumCC; ++i)
 			{
-				const auto idStr = var->toString();
-
-				auto& cc = ccBuf[i];
-				const auto pID = param::toPID(idStr);
-				cc.param.store(params[pID]);
+				const auto var = state.get("midilearn/cc" + String(i), "id");
+				if (var == nullptr)
+					continue;
+				const auto pID = param::toPID(var->toString());
+				if (pID != PID::NumParams)
+					nMappings.push_back({ Source::CC, i, pID, 0.f, 1.f, 0.f, 0.f });
 			}
+			return setMappings(std::move(nMappings));
+		}
+
+		const auto numMappings = static_cast<int>(*num);
+		for (auto i = 0; i < numMappings; ++i)
+		{
+			const auto idStr = getIDString(i);
+			const auto src = state.get(idStr, "source");
+			const auto number = state.get(idStr, "number");
+			const auto id = state.get(idStr, "id");
+			if (src == nullptr || number == nullptr || id == nullptr)
+				continue;
+			const auto pID = param::toPID(id->toString());
+			const auto source = static_cast<int>(*src);
+			if (pID == PID::NumParams || source < 0 || source >= static_cast<int>(Source::NumSources))
+				continue;
+
+			const auto getFloat = [&](const String& prop, float defaultVal)
+			{
+				const auto var = state.get(idStr, prop);
+				return var == nullptr ? defaultVal : static_cast<float>(*var);
+			};
+
+			nMappings.push_back({
+				static_cast<Source>(source),
+				static_cast<int>(*number),
+				pID,
+				getFloat("min", 0.f),
+				getFloat("max", 1.f),
+				getFloat("curve", 0.f),
+				getFloat("smooth", 0.f)
+			});
 		}
+		setMappings(std::move(nMappings));
 	}
 
 	void MIDILearn::processBlockInit() noexcept
 	{
 		c = -1;
+		if (middleIdx.load(std::memory_order_relaxed) & NewBit)
+			frontIdx = middleIdx.exchange(frontIdx, std::memory_order_acq_rel) & IdxMask;
 	}
 
 	void MIDILearn::processBlockMIDICC(const MIDIMessage& msg) noexcept
 	{
-		c = msg.getControllerNumber();
-		if (c < ccBuf.size())
+		const auto cc = msg.getControllerNumber();
+		if (cc >= NumCC)
+			return;
+		c = cc;
+
+		const auto ch = msg.getChannel() - 1;
+		const auto val = msg.getControllerValue();
+		auto& decoder = decoders[ch];
+
+		switch (cc)
 		{
-			auto& cc = ccBuf[c];
+		case 99:
+			decoder.nrpn = (val << 7) | (decoder.nrpn < 0 ? 0 : decoder.nrpn & 127);
+			break;
+		case 98:
+			decoder.nrpn = (decoder.nrpn < 0 ? 0 : decoder.nrpn & (127 << 7)) | val;
+			break;
+		case 101:
+		case 100:
+			// a rpn is selected
+			decoder.nrpn = -1;
+			break;
+		case 6:
+			decoder.dataMSB = val;
+			decoder.dataLSB = 0;
+			break;
+		case 38:
+			decoder.dataLSB = val;
+			break;
+		default:
+			break;
+		}
+		// 127, 127 is the null nrpn
+		if (decoder.nrpn == 16383)
+			decoder.nrpn = -1;
+		if (cc < NumCC14)
+			decoder.msb[cc] = val;
 
-			auto ap = assignableParam.load();
-			if (ap != nullptr)
-			{
-				cc.param.store(ap);
-				assignableParam.store(nullptr);
-			}
+		if (assignableParam.load() != nullptr || learnedMSBParam != nullptr)
+			learn(ch, cc);
 
-			cc.setValue(msg.getControllerValue());
+		const auto& table = tables[frontIdx];
+		if (table.targets.empty())
+			return;
+
+		dispatch(cc, static_cast<float>(val) * ValInv7, cc);
+
+		if (cc < NumCC14)
+		{
+			dispatch(NumCC + cc, static_cast<float>(val << 7) * ValInv14, cc);
+		}
+		else if (cc < NumCC14 * 2)
+		{
+			const auto n = cc - NumCC14;
+			dispatch(NumCC + n, static_cast<float>((decoder.msb[n] << 7) | val) * ValInv14, cc);
+		}
+
+		if ((cc == 6 || cc == 38) && decoder.nrpn >= 0)
+		{
+			const auto slot = table.getNRPNSlot(decoder.nrpn);
+			if (slot != -1)
+				dispatch(slot, static_cast<float>((decoder.dataMSB << 7) | decoder.dataLSB) * ValInv14, cc);
 		}
 	}
 
-	void MIDILearn::processBlockEnd() noexcept
+	void MIDILearn::processBlockEnd(int numSamples) noexcept
 	{
+		const auto numSamplesF = static_cast<float>(numSamples);
+		for (auto i = 0; i < param::NumParams; ++i)
+		{
+			auto& s = smoothers[i];
+			if (!s.active)
+				continue;
+			const auto coeff = 1.f - std::exp(-numSamplesF / (s.ms * .001f * Fs));
+			s.value += coeff * (s.dest - s.value);
+			if (std::abs(s.dest - s.value) < .0001f)
+			{
+				s.value = s.dest;
+				s.active = false;
+			}
+			apply(params[i], s.value, s.cc);
+		}
+
 		if (c != -1)
 			ccIdx.store(c);
 	}
@@ -88,16 +234,238 @@ namespace audio
 		assignableParam.store(param);
 	}
 
-	void MIDILearn::removeParam(Param* param) noexcept
+	void MIDILearn::removeParam(Param* param)
+	{
+		const juce::ScopedLock lock(mappingsLock);
+		const auto pID = param->id;
+		mappings.erase(std::remove_if(mappings.begin(), mappings.end(), [pID](const Mapping& m)
+		{
+			return m.pID == pID;
+		}), mappings.end());
+		compile();
+	}
+
+	std::vector<MIDILearn::Mapping> MIDILearn::getMappings() const
+	{
+		const juce::ScopedLock lock(mappingsLock);
+		return mappings;
+	}
+
+	void MIDILearn::setMappings(std::vector<Mapping>&& nMappings)
+	{
+		const juce::ScopedLock lock(mappingsLock);
+		mappings = std::move(nMappings);
+		compile();
+	}
+
+	void MIDILearn::addMapping(const Mapping& mapping)
+	{
+		const juce::ScopedLock lock(mappingsLock);
+		mappings.push_back(mapping);
+		compile();
+	}
+
+	void MIDILearn::compile()
+	{
+		auto& table = tables[backIdx];
+
+		table.nrpnNumbers.clear();
+		for (const auto& m : mappings)
+			if (m.source == Source::NRPN)
+				table.nrpnNumbers.push_back(m.number);
+		std::sort(table.nrpnNumbers.begin(), table.nrpnNumbers.end());
+		table.nrpnNumbers.erase(std::unique(table.nrpnNumbers.begin(), table.nrpnNumbers.end()), table.nrpnNumbers.end());
+
+		// counting sort of the targets by slot
+		const auto numSlots = NumCC + NumCC14 + static_cast<int>(table.nrpnNumbers.size());
+		table.offsets.assign(numSlots + 1, 0);
+		std::vector<int> slots;
+		slots.reserve(mappings.size());
+		for (const auto& m : mappings)
+		{
+			const auto slot = getSlot(m, table.nrpnNumbers);
+			slots.push_back(slot);
+			if (slot != -1)
+				++table.offsets[slot + 1];
+		}
+		for (auto i = 0; i < numSlots; ++i)
+			table.offsets[i + 1] += table.offsets[i];
+
+		table.targets.resize(table.offsets[numSlots]);
+		auto fill = table.offsets;
+		for (auto i = 0; i < static_cast<int>(mappings.size()); ++i)
+		{
+			const auto slot = slots[i];
+			if (slot == -1)
+				continue;
+			const auto& m = mappings[i];
+
+			const auto curve = juce::jlimit(-1.f, 1.f, m.curve);
+			table.targets[fill[slot]++] =
+			{
+				params[m.pID],
+				m.min,
+				m.max - m.min,
+				std::pow(4.f, -curve),
+				std::max(m.smoothMs, 0.f)
+			};
+		}
+
+		backIdx = middleIdx.exchange(backIdx | NewBit, std::memory_order_acq_rel) & IdxMask;
+	}
+
+	int MIDILearn::getSlot(const Mapping& m, const std::vector<int>& nrpnNumbers) const noexcept
 	{
-		for (auto& cc : ccBuf)
-			if (param == cc.param)
-				cc.param.store(nullptr);
+		switch (m.source)
+		{
+		case Source::CC:
+			return m.number >= 0 && m.number < NumCC ? m.number : -1;
+		case Source::CC14:
+			return m.number >= 0 && m.number < NumCC14 ? NumCC + m.number : -1;
+		case Source::NRPN:
+		{
+			const auto it = std::lower_bound(nrpnNumbers.begin(), nrpnNumbers.end(), m.number);
+			return NumCC + NumCC14 + static_cast<int>(it - nrpnNumbers.begin());
+		}
+		default:
+			return -1;
+		}
+	}
+
+	void MIDILearn::learn(int ch, int cc) noexcept
+	{
+		// the lsb right after a learned msb makes it a 14 bit controller
+		if (learnedMSBParam != nullptr)
+		{
+			if (cc == learnedMSB + NumCC14)
+				learned.push({ Source::CC14, learnedMSB, learnedMSBParam->id });
+			learnedMSBParam = nullptr;
+		}
+
+		auto ap = assignableParam.load();
+		if (ap == nullptr)
+			return;
+
+		switch (cc)
+		{
+		case 99: case 98: case 101: case 100:
+			// waits for the data entry
+			return;
+		case 6: case 38:
+			if (decoders[ch].nrpn >= 0)
+			{
+				learned.push({ Source::NRPN, decoders[ch].nrpn, ap->id });
+				break;
+			}
+			learned.push({ Source::CC, cc, ap->id });
+			break;
+		default:
+			learned.push({ Source::CC, cc, ap->id });
+			if (cc < NumCC14)
+			{
+				learnedMSB = cc;
+				learnedMSBParam = ap;
+			}
+			break;
+		}
+
+		assignableParam.store(nullptr);
+	}
+
+	void MIDILearn::dispatch(int slot, float value, int cc) noexcept
+	{
+		auto& table = tables[frontIdx];
+		const auto end = table.offsets[slot + 1];
+		for (auto i = table.offsets[slot]; i < end; ++i)
+		{
+			const auto& target = table.targets[i];
+			const auto v = target.min + target.range * std::pow(value, target.expo);
+			if (target.smoothMs == 0.f)
+			{
+				apply(target.param, v, cc);
+				continue;
+			}
+
+			auto& s = smoothers[static_cast<int>(target.param->id)];
+			if (!s.active)
+			{
+				s.value = target.param->getValue();
+				s.active = true;
+			}
+			s.ms = target.smoothMs;
+			s.dest = v;
+			s.cc = cc;
+		}
+	}
+
+	void MIDILearn::apply(Param* param, float value, int cc) noexcept
+	{
+		if (param->isInGesture())
+			return;
+		// the param has the value already. if the queue is full, the host misses it
+		param->setValue(value);
+		changes.push({ cc, static_cast<int>(param->id), value });
 	}
 
 	String MIDILearn::getIDString(int idx) const
 	{
-		return "midilearn/cc" + String(idx);
+		return "midilearn/mapping" + String(idx);
 	}
-}
 
+	void MIDILearn::timerCallback()
+	{
+		{
+			const juce::ScopedLock lock(mappingsLock);
+			Learned l;
+			auto numLearned = 0;
+			while (learned.pop(l))
+			{
+				auto upgraded = false;
+				if (l.source == Source::CC14)
+					for (auto& m : mappings)
+						if (m.source == Source::CC && m.number == l.number && m.pID == l.pID)
+						{
+							m.source = Source::CC14;
+							upgraded = true;
+						}
+
+				auto exists = false;
+				for (const auto& m : mappings)
+					exists = exists || (m.source == l.source && m.number == l.number && m.pID == l.pID);
+
+				if (!upgraded && !exists)
+					mappings.push_back({ l.source, l.number, l.pID, 0.f, 1.f, 0.f, 0.f });
+				++numLearned;
+			}
+			if (numLearned != 0)
+				compile();
+		}
+
+		// only the last value of every param is sent
+		Change change;
+		auto any = false;
+		while (changes.pop(change))
+		{
+			pendingValues[change.pID] = change.value;
+			pending[change.pID] = true;
+			any = true;
+		}
+		if (!any)
+			return;
+
+		const auto numParams = static_cast<int>(params.numParams());
+		for (auto i = 0; i < numParams; ++i)
+		{
+			if (!pending[i])
+				continue;
+			pending[i] = false;
+
+			auto p = params[i];
+			if (p->isInGesture())
+				continue;
+			p->beginChangeGesture();
+			p->sendValueChangedMessageToListeners(pendingValues[i]);
+			p->endChangeGesture();
+		}
+	}
+}
@@ -5,44 +5,207 @@
 
 namespace audio
 {
-	class MIDILearn
+	// a table of mappings from controllers to params. one controller can drive many params
+	// and many controllers can drive one param, each with its own range, curve and smoothing.
+	// the message thread compiles the table into flat slots, so that the audio thread only
+	// visits the targets of a message. the compiled tables are published through a triple buffer.
+	// the audio thread writes the values straight into the params. the host only hears about them
+	// on the message thread: the changes are queued lock-free and drained at DrainFPS,
+	// with at most one notification per param per drain.
+	// the mappings are edited under one lock, because the host can load a patch on any thread.
+	// the editor only learns (cc, 14 bit cc or nrpn) and removes mappings with the default range,
+	// curve and smoothing. other values come from patches, there is no editor for them yet.
+	class MIDILearn :
+		public juce::Timer
 	{
-		static constexpr float ValInv = 1.f / 128.f;
+		static constexpr float ValInv7 = 1.f / 127.f;
+		static constexpr float ValInv14 = 1.f / 16383.f;
+		static constexpr int DrainFPS = PPDFPSKnobs;
+		static constexpr int NumBuffers = 3;
+		static constexpr int NewBit = 4;
+		static constexpr int IdxMask = 3;
+	public:
+		// 120 to 127 are channel mode messages
+		static constexpr int NumCC = 120;
+		static constexpr int NumCC14 = 32;
 
-		struct CC
+		enum class Source
 		{
-			CC();
-
-			void setValue(int);
+			CC, // 7 bit
+			CC14, // msb on cc n, lsb on cc n + 32
+			NRPN, // number on cc 99 and 98, value on cc 6 and 38
+			NumSources
+		};
 
-			std::atomic<param::Param*> param;
+		struct Mapping
+		{
+			Source source;
+			// cc [0, NumCC), cc14 [0, NumCC14), nrpn [0, 16383]
+			int number;
+			PID pID;
+			// the range of the param's normalized value
+			float min, max;
+			// [-1, 1], 0 is linear, positive values rise faster
+			float curve;
+			// 0 applies the values as they come
+			float smoothMs;
 		};
 
-	public:
 		MIDILearn(Params&, State&);
 
+		~MIDILearn();
+
+		/* Fs */
+		void prepare(float);
+
 		void savePatch() const;
-		
+
 		void loadPatch();
 
 		void processBlockInit() noexcept;
 
 		void processBlockMIDICC(const MIDIMessage& msg) noexcept;
 
-		void processBlockEnd() noexcept;
+		/* numSamples */
+		void processBlockEnd(int) noexcept;
 
+		/* the next controller gets mapped to this param */
 		void assignParam(param::Param*) noexcept;
-		
-		void removeParam(param::Param*) noexcept;
 
-		std::array<CC, 120> ccBuf;
+		/* removes all mappings of this param */
+		void removeParam(param::Param*);
+
+		// thread-safe, but not realtime-safe
+
+		std::vector<Mapping> getMappings() const;
+
+		void setMappings(std::vector<Mapping>&&);
+
+		void addMapping(const Mapping&);
+
 		std::atomic<int> ccIdx;
 	protected:
+		// lock-free, one producer (the audio thread) and one consumer (the message thread)
+		template<typename T, int Size>
+		struct Queue
+		{
+			Queue() :
+				items(),
+				writeIdx(0),
+				readIdx(0)
+			{}
+
+			/* returns false if the queue is full */
+			bool push(const T& item) noexcept
+			{
+				const auto w = writeIdx.load(std::memory_order_relaxed);
+				const auto next = (w + 1) % Size;
+				if (next == readIdx.load(std::memory_order_acquire))
+					return false;
+				items[w] = item;
+				writeIdx.store(next, std::memory_order_release);
+				return true;
+			}
+
+			/* returns false if the queue is empty */
+			bool pop(T& item) noexcept
+			{
+				const auto r = readIdx.load(std::memory_order_relaxed);
+				if (r == writeIdx.load(std::memory_order_acquire))
+					return false;
+				item = items[r];
+				readIdx.store((r + 1) % Size, std::memory_order_release);
+				return true;
+			}
+
+		protected:
+			std::array<T, Size> items;
+			std::atomic<int> writeIdx, readIdx;
+		};
+
+		struct Change
+		{
+			int cc, pID;
+			float value;
+		};
+
+		struct Learned
+		{
+			Source source;
+			int number;
+			PID pID;
+		};
+
+		struct Target
+		{
+			Param* param;
+			// smoothMs 0 applies the values as they come
+			float min, range, expo, smoothMs;
+		};
+
+		// one per param, outside of the tables, so that a glide survives a new table
+		struct Smoother
+		{
+			int cc;
+			float ms, value, dest;
+			bool active;
+		};
+
+		// slots: cc [0, NumCC), cc14 [NumCC, NumCC + NumCC14), then the nrpn numbers in order.
+		// the targets of slot i are [offsets[i], offsets[i + 1])
+		struct Table
+		{
+			std::vector<int> offsets, nrpnNumbers;
+			std::vector<Target> targets;
+
+			/* nrpn number, returns -1 if it has no slot */
+			int getNRPNSlot(int) const noexcept;
+		};
+
+		// the running status of a midi channel
+		struct Decoder
+		{
+			std::array<int, NumCC14> msb;
+			int nrpn, dataMSB, dataLSB;
+		};
+
 		std::atomic<param::Param*> assignableParam;
 		Params& params;
 		State& state;
-		int c;
+		juce::CriticalSection mappingsLock;
+		std::vector<Mapping> mappings;
+		std::array<Table, NumBuffers> tables;
+		int backIdx;
+		std::atomic<int> middleIdx;
+		int frontIdx;
+		std::array<Decoder, 16> decoders;
+		std::array<Smoother, param::NumParams> smoothers;
+		Queue<Change, 512> changes;
+		Queue<Learned, 16> learned;
+		std::array<float, param::NumParams> pendingValues;
+		std::array<bool, param::NumParams> pending;
+		param::Param* learnedMSBParam;
+		float Fs;
+		int c, learnedMSB;
+
+		/* compiles the mappings into the back table and publishes it, with mappingsLock held */
+		void compile();
+
+		/* mapping */
+		int getSlot(const Mapping&, const std::vector<int>&) const noexcept;
+
+		/* channel, cc, the learn state machine */
+		void learn(int, int) noexcept;
+
+		/* slot, value [0, 1], cc */
+		void dispatch(int, float, int) noexcept;
+
+		/* param, value, cc */
+		void apply(Param*, float, int) noexcept;
 
 		String getIDString(int) const;
+
+		/* drains the learned controllers and the changes, notifies the host */
+		void timerCallback() override;
 	};
-}
\ No newline at end of file
+}
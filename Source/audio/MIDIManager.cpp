@@ -6,29 +6,8 @@ namespace audio
 
 	MIDIManager::MIDIManager(Params& params, State& state) :
 		midiLearn(params, state),
-		onInit(),
-		onEnd(),
-		onSample(),
-		onCC(),
-		onNoteOn(),
-		onNoteOff(),
-		onPitchbend(),
-		onNoEvt()
+		learnHandler(midiLearn)
 	{
-		onInit.push_back([&learn = midiLearn](int)
-		{
-			learn.processBlockInit();
-		});
-
-		onCC.push_back([&learn = midiLearn](const MIDIMessage& msg, int)
-		{
-			learn.processBlockMIDICC(msg);
-		});
-
-		onEnd.push_back([&learn = midiLearn](int)
-		{
-			learn.processBlockEnd();
-		});
 	}
 
 	void MIDIManager::savePatch()
@@ -41,82 +20,24 @@ namespace audio
 		midiLearn.loadPatch();
 	}
 
-	void MIDIManager::operator()(MIDIBuffer& midi, int numSamples) noexcept
+	MIDIManager::LearnHandler::LearnHandler(MIDILearn& _learn) :
+		learn(_learn)
 	{
-		if (midi.isEmpty())
-			processEmpty(numSamples);
-		else
-			processBlock(midi, numSamples);
 	}
 
-	void MIDIManager::processEmpty(int numSamples) noexcept
+	void MIDIManager::LearnHandler::onInit(int) noexcept
 	{
-		for (auto& func : onInit)
-			func(numSamples);
-		for (auto& func : onEnd)
-			func(numSamples);
+		learn.processBlockInit();
 	}
 
-	void MIDIManager::processBlock(MIDIBuffer& midi, int numSamples) noexcept
+	void MIDIManager::LearnHandler::onCC(const MIDIMessage& msg, int) noexcept
 	{
-		for (auto& func : onInit)
-			func(numSamples);
-
-		auto evt = midi.begin();
-		auto ref = *evt;
-		auto ts = ref.samplePosition;
-		for (auto s = 0; s < numSamples; ++s)
-		{
-			if (ts > s)
-			{
-				for (auto& func : onNoEvt)
-					func(s);
-			}
-			else
-			{
-				//bool noteOn = env.noteOn;
-				while (ts == s)
-				{
-					const auto msg = ref.getMessage();
-
-					if (msg.isNoteOn())
-					{
-						for (auto& func : onNoteOn)
-							func(msg, s);
-					}
-					else if (msg.isNoteOff())
-					{
-						for (auto& func : onNoteOff)
-							func(msg, s);
-					}
-					else if (msg.isPitchWheel())
-					{
-						for (auto& func : onPitchbend)
-							func(msg, s);
-					}
-					else if (msg.isController())
-					{
-						for (auto& func : onCC)
-							func(msg, s);
-					}
-					++evt;
-					if (evt == midi.end())
-						ts = numSamples;
-					else
-					{
-						ref = *evt;
-						ts = ref.samplePosition;
-					}
-				}
-				for (auto& func : onSample)
-					func(s);
-				//bufNotes[s] = currentValue;
-				//bufEnv[s] = env(noteOn) * SafetyCoeff;
-			}
-		}
+		learn.processBlockMIDICC(msg);
+	}
 
-		for (auto& func : onEnd)
-			func(numSamples);
+	void MIDIManager::LearnHandler::onEnd(int numSamples) noexcept
+	{
+		learn.processBlockEnd(numSamples);
 	}
 
 	// MIDINoteBuffer
@@ -203,46 +124,33 @@ namespace audio
 
 	// MIDIVoices
 
-	MIDIVoices::MIDIVoices(audio::MIDIManager& manager) :
+	MIDIVoices::MIDIVoices() :
 		voices(),
 		pitchbendBuffer(),
 		pitchbendRange(2.f),
 		voiceIndex(0)
 	{
-		manager.onInit.push_back([this](int)
-			{
-				for (auto& voice : voices)
-					voice.sampleIdx = 0;
-				pitchbendBuffer.processInit();
-			});
+	}
+
+	void MIDIVoices::onInit(int) noexcept
+	{
+		for (auto& voice : voices)
+			voice.sampleIdx = 0;
+		pitchbendBuffer.processInit();
+	}
+
 #if PPD_MIDINumVoices != 0
-		manager.onNoteOn.push_back([this](const MIDIMessage& msg, int s)
-			{
-				for (auto v = 1; v < PPD_MIDINumVoices; ++v)
-				{
-					auto nIdx = (voiceIndex + v) % PPD_MIDINumVoices;
-					auto& voice = voices[voiceIndex];
+	void MIDIVoices::onNoteOn(const MIDIMessage& msg, int s) noexcept
+	{
+		for (auto v = 1; v < PPD_MIDINumVoices; ++v)
+		{
+			auto nIdx = (voiceIndex + v) % PPD_MIDINumVoices;
+			auto& voice = voices[voiceIndex];
 
-					if (!voice.curNote.noteOn)
-					{
-						voiceIndex = nIdx;
-						voice.processNoteOn(
-							{
-								msg.getFloatVelocity(),
-								msg.getNoteNumber(),
-								true
-							},
-							s
-						);
-						return;
-					}
-				}
-
-				voiceIndex = (voiceIndex + 1) % PPD_MIDINumVoices;
-				auto& voice = voices[voiceIndex];
-
-				voice.processNoteOn
-				(
+			if (!voice.curNote.noteOn)
+			{
+				voiceIndex = nIdx;
+				voice.processNoteOn(
 					{
 						msg.getFloatVelocity(),
 						msg.getNoteNumber(),
@@ -250,36 +158,53 @@ namespace audio
 					},
 					s
 				);
-			});
+				return;
+			}
+		}
 
-		manager.onNoteOff.push_back([this](const MIDIMessage& msg, int s)
+		voiceIndex = (voiceIndex + 1) % PPD_MIDINumVoices;
+		auto& voice = voices[voiceIndex];
+
+		voice.processNoteOn
+		(
 			{
-				auto noteNumber = msg.getNoteNumber();
+				msg.getFloatVelocity(),
+				msg.getNoteNumber(),
+				true
+			},
+			s
+		);
+	}
+
+	void MIDIVoices::onNoteOff(const MIDIMessage& msg, int s) noexcept
+	{
+		auto noteNumber = msg.getNoteNumber();
 
-				for (auto v = 0; v < PPD_MIDINumVoices; ++v)
-				{
-					const auto v1 = (voiceIndex + 1 + v) % PPD_MIDINumVoices;
+		for (auto v = 0; v < PPD_MIDINumVoices; ++v)
+		{
+			const auto v1 = (voiceIndex + 1 + v) % PPD_MIDINumVoices;
 
-					auto& voice = voices[v1];
+			auto& voice = voices[v1];
 
-					if (voice.curNote.noteOn && voice.curNote.noteNumber == noteNumber)
-						return voice.processNoteOff(s);
-				}
-			});
+			if (voice.curNote.noteOn && voice.curNote.noteNumber == noteNumber)
+				return voice.processNoteOff(s);
+		}
+	}
 #endif
-		manager.onPitchbend.push_back([this](const MIDIMessage& msg, int s)
-			{
-				const auto pwv = static_cast<float>(msg.getPitchWheelValue());
-				const auto pbNorm = (pwv - 8192.f) * .0001220703125f;
-				const auto val = pbNorm * pitchbendRange;
-				pitchbendBuffer.processPitchbend(val, s);
-			});
-		manager.onEnd.push_back([this](int numSamples)
-			{
-				for (auto& voice : voices)
-					voice.process(numSamples);
-				pitchbendBuffer.process(numSamples);
-			});
+
+	void MIDIVoices::onPitchbend(const MIDIMessage& msg, int s) noexcept
+	{
+		const auto pwv = static_cast<float>(msg.getPitchWheelValue());
+		const auto pbNorm = (pwv - 8192.f) * .0001220703125f;
+		const auto val = pbNorm * pitchbendRange;
+		pitchbendBuffer.processPitchbend(val, s);
+	}
+
+	void MIDIVoices::onEnd(int numSamples) noexcept
+	{
+		for (auto& voice : voices)
+			voice.process(numSamples);
+		pitchbendBuffer.process(numSamples);
 	}
 
 	void MIDIVoices::prepare(int blockSize)
@@ -1,9 +1,30 @@
 #pragma once
 #include "MIDILearn.h"
-#include <functional>
 
 namespace audio
 {
+	// base of the handlers of MIDIManager.
+	// a handler hides the callbacks it needs, the empty rest is inlined away.
+	struct MIDIHandler
+	{
+		/* numSamples */
+		void onInit(int) noexcept {}
+		/* numSamples */
+		void onEnd(int) noexcept {}
+		/* midiMessage, sampleIndex */
+		void onCC(const MIDIMessage&, int) noexcept {}
+		/* midiMessage, sampleIndex */
+		void onNoteOn(const MIDIMessage&, int) noexcept {}
+		/* midiMessage, sampleIndex */
+		void onNoteOff(const MIDIMessage&, int) noexcept {}
+		/* midiMessage, sampleIndex */
+		void onPitchbend(const MIDIMessage&, int) noexcept {}
+		/* sampleIndex, after all events of that sample */
+		void onSample(int) noexcept {}
+		/* startIdx, endIdx, a range of samples without events */
+		void onNoEvt(int, int) noexcept {}
+	};
+
 	struct MIDIManager
 	{
 		MIDIManager(Params&, State&);
@@ -12,24 +33,74 @@ namespace audio
 
 		void loadPatch();
 
-		/* midiBuffer, numSamples */
-		void operator()(MIDIBuffer&, int) noexcept;
+		/* midiBuffer, numSamples, handlers...
+		midi learn is always handled first, then the handlers in the given order.
+		the handlers are known at compile time, so there are no indirect calls. */
+		template<typename... Handlers>
+		void operator()(MIDIBuffer& midi, int numSamples, Handlers&... handlers) noexcept
+		{
+			process(midi, numSamples, learnHandler, handlers...);
+		}
 
 		MIDILearn midiLearn;
-
-		/* numSamples */
-		std::vector<std::function<void(int)>> onInit, onEnd, onSample;
-		/* midiMessage, sampleIndex */
-		std::vector<std::function<void(const MIDIMessage&, int)>> onCC, onNoteOn, onNoteOff, onPitchbend;
-		/* sampleIndex */
-		std::vector<std::function<void(int)>> onNoEvt;
 	protected:
-
-		/* numSamples */
-		void processEmpty(int) noexcept;
-
-		/* midiBuffer, numSamples */
-		void processBlock(MIDIBuffer&, int) noexcept;
+		struct LearnHandler :
+			public MIDIHandler
+		{
+			LearnHandler(MIDILearn&);
+
+			void onInit(int) noexcept;
+			void onCC(const MIDIMessage&, int) noexcept;
+			void onEnd(int) noexcept;
+
+			MIDILearn& learn;
+		};
+
+		LearnHandler learnHandler;
+
+		/* midiBuffer, numSamples, handlers... */
+		template<typename... Handlers>
+		static void process(MIDIBuffer& midi, int numSamples, Handlers&... handlers) noexcept
+		{
+			(handlers.onInit(numSamples), ...);
+
+			// only the samples with events are visited.
+			// events before the block are dispatched at sample 0
+			auto s = 0;
+			auto evt = midi.begin();
+			const auto end = midi.end();
+			while (evt != end)
+			{
+				const auto ts = std::max((*evt).samplePosition, 0);
+				if (ts >= numSamples)
+					break;
+				if (ts > s)
+					(handlers.onNoEvt(s, ts), ...);
+
+				do
+				{
+					const auto msg = (*evt).getMessage();
+
+					if (msg.isNoteOn())
+						(handlers.onNoteOn(msg, ts), ...);
+					else if (msg.isNoteOff())
+						(handlers.onNoteOff(msg, ts), ...);
+					else if (msg.isPitchWheel())
+						(handlers.onPitchbend(msg, ts), ...);
+					else if (msg.isController())
+						(handlers.onCC(msg, ts), ...);
+
+					++evt;
+				} while (evt != end && std::max((*evt).samplePosition, 0) == ts);
+
+				(handlers.onSample(ts), ...);
+				s = ts + 1;
+			}
+			if (s < numSamples)
+				(handlers.onNoEvt(s, numSamples), ...);
+
+			(handlers.onEnd(numSamples), ...);
+		}
 	};
 
 	struct MIDINote
@@ -82,13 +153,22 @@ namespace audio
 		int sampleIdx;
 	};
 
-	struct MIDIVoices
+	struct MIDIVoices :
+		public MIDIHandler
 	{
-		MIDIVoices(MIDIManager&);
+		MIDIVoices();
 
 		/* blockSize */
 		void prepare(int);
 
+		void onInit(int) noexcept;
+#if PPD_MIDINumVoices != 0
+		void onNoteOn(const MIDIMessage&, int) noexcept;
+		void onNoteOff(const MIDIMessage&, int) noexcept;
+#endif
+		void onPitchbend(const MIDIMessage&, int) noexcept;
+		void onEnd(int) noexcept;
+
 		MIDIVoicesArray voices;
 		MIDIPitchbendBuffer pitchbendBuffer;
 		float pitchbendRange;
@@ -1,4 +1,5 @@
 #include "Meter.h"
+#include <algorithm>
 #include <cmath>
 
 namespace audio
@@ -6,8 +7,7 @@ namespace audio
 	// Meters::Val
 	
 	Meters::Val::Val() :
-		rect(0.f),
-		val(0.f),
+		detector(),
 		env(0.f),
 		envFol()
 	{};
@@ -16,36 +16,34 @@ namespace audio
 
 	Meters::Meters() :
 		vals(),
-		wHead(),
-		lenInv(1.f),
-		length(1)
+		length(1),
+		pos(0)
 	{
 	}
 
 	void Meters::prepare(float sampleRate, int blockSize)
 	{
 		length = static_cast<int>(sampleRate / PPDFPSMeters);
-		wHead.prepare(blockSize, length);
-		lenInv = 1.f / static_cast<float>(length);
+		pos = 0;
 		for (auto& v : vals)
+		{
+			v.detector.prepare(blockSize, DetectorMode);
 			v.envFol.prepare(PPDFPSMeters);
+			v.envFol.setTimes(RiseInMs, FallInMs);
+		}
 	}
 
 #if PPDHasGainIn
 	void Meters::processIn(const float* const* samples, int numChannels, int numSamples) noexcept
 	{
-		wHead(numSamples);
-
 		process(vals[Type::In], samples, numChannels, numSamples);
 	}
 #endif
 
 	void Meters::processOut(const float* const* samples, int numChannels, int numSamples) noexcept
 	{
-#if !PPDHasGainIn
-		wHead(numSamples);
-#endif
 		process(vals[Type::Out], samples, numChannels, numSamples);
+		pos = (pos + numSamples) % length;
 	}
 
 	const std::atomic<float>& Meters::operator()(int i) const noexcept
@@ -55,105 +53,23 @@ namespace audio
 
 	void Meters::process(Val& val, const float* const* samples, int numChannels, int numSamples) noexcept
 	{
-		auto& rect = val.rect;
-		auto& vVal = val.val;
-		auto& envFol = val.envFol;
-
-#if PPDMetersUseRMS
-		if (numChannels == 1)
-		{
-			auto smpls = samples[0];
-
-
-			for (auto s = 0; s < numSamples; ++s)
-			{
-				const auto w = wHead[s];
-
-				if (w == 0)
-				{
-					vVal = std::sqrt(rect * lenInv);
-					val.env.store(envFol.process(
-						vVal,
-						RiseInMs,
-						FallInMs
-					));
-
-					rect = 0.f;
-				}
-
-				const auto smpl = smpls[s];
-				rect += smpl * smpl;
-			}
-		}
-		else
-		{
-			for (auto s = 0; s < numSamples; ++s)
-			{
-				const auto w = wHead[s];
-
-				if (w == 0)
-				{
-					vVal = std::sqrt(rect * lenInv) * .5f;
-					val.env.store(envFol.process(
-						vVal,
-						RiseInMs,
-						FallInMs
-					));
-
-					rect = 0.f;
-				}
-
-				const auto smpl = samples[0][s] + samples[1][s];
-				rect += smpl * smpl;
-			}
-		}
-#else
-		if (numChannels == 1)
+		auto w = pos;
+		for (auto s = 0; s < numSamples;)
 		{
-			const auto smpls = samples[0];
-
-			for (auto s = 0; s < numSamples; ++s)
-			{
-				const auto w = wHead[s];
-
-				if (w == 0)
-				{
-					vVal = std::sqrt(rect);
-					val.env.store(envFol.process(
-						vVal,
-						RiseInMs,
-						FallInMs
-					));
-
-					rect = 0.f;
-				}
-
-				const auto smpl = smpls[s];
-				rect = rect < smpl ? smpl : rect;
-			}
+			if (w == 0)
+				update(val, numChannels);
+
+			const auto n = std::min(numSamples - s, length - w);
+			val.detector(samples, numChannels, s, n);
+			s += n;
+			w += n;
+			if (w == length)
+				w = 0;
 		}
-		else
-		{
-			for (auto s = 0; s < numSamples; ++s)
-			{
-				const auto w = wHead[s];
-
-				if (w == 0)
-				{
-					vVal = rect * .5f;
-					val.env.store(envFol.process(
-						vVal,
-						RiseInMs,
-						FallInMs
-					));
-
-					rect = 0.f;
-				}
+	}
 
-				const auto smpl = samples[0][s] + samples[1][s];
-				rect = rect < smpl ? smpl : rect;
-			}
-		}
-#endif
+	void Meters::update(Val& val, int numChannels) noexcept
+	{
+		val.env.store(val.envFol.process(val.detector.flush(numChannels)));
 	}
-}
\ No newline at end of file
+}
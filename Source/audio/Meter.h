@@ -1,5 +1,4 @@
 #pragma once
-#include "WHead.h"
 #include "EnvelopeFollower.h"
 #include <array>
 #include <atomic>
@@ -9,12 +8,19 @@ namespace audio
 	class Meters
 	{
 		static constexpr float RiseInMs = .01f, FallInMs = 42.f;
+#if PPDMetersUseRMS
+		static constexpr LevelDetector::Mode DetectorMode = LevelDetector::Mode::RMS;
+#elif PPDMetersUseTruePeak
+		static constexpr LevelDetector::Mode DetectorMode = LevelDetector::Mode::TruePeak;
+#else
+		static constexpr LevelDetector::Mode DetectorMode = LevelDetector::Mode::Peak;
+#endif
 
 		struct Val
 		{
 			Val();
 
-			float rect, val;
+			LevelDetector detector;
 			std::atomic<float> env;
 			EnvFol envFol;
 		};
@@ -45,12 +51,15 @@ namespace audio
 
 	protected:
 		std::array<Val, NumTypes> vals;
-		WHead wHead;
-		float lenInv;
-		int length;
+		// pos is where the block starts in the current window of length samples
+		int length, pos;
 
 	private:
-		/* val, samples, numChannels, numSamples */
+		/* val, samples, numChannels, numSamples
+		the block is processed in spans that end where a window ends */
 		void process(Val&, const float* const*, int, int) noexcept;
+
+		/* val, numChannels, called where a window ends */
+		void update(Val&, int) noexcept;
 	};
 }
\ No newline at end of file
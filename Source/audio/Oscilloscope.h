@@ -1,80 +1,312 @@
 #pragma once
 #include "AudioUtils.h"
-#include "WHead.h"
+#include "RingBuffer.h"
 #include "Phasor.h"
 
 namespace audio
 {
-	struct Oscilloscope
+	// a few disjoint sample ranges, sorted and merged where they touch.
+	// a wrap or a retrig stays two small spans instead of one that covers the whole window.
+	// if there are more than MaxSpans, the two closest ones merge.
+	struct OscopeSpans
 	{
-		Oscilloscope() :
-			wHead(),
-			buffer(),
-			phasor(0.),
-			beatLength(1.f),
-			Fs(0.)
+		static constexpr int MaxSpans = 4;
+
+		struct Span
+		{
+			int lo, hi;
+		};
+
+		OscopeSpans() :
+			spans(),
+			numSpans(0)
 		{}
 
-		void prepare(double sampleRate, int blockSize)
+		void clear() noexcept
 		{
-			Fs = sampleRate;
+			numSpans = 0;
+		}
 
-			auto windowSize = static_cast<int>(Fs) * 4;
-			wHead.prepare(blockSize, windowSize);
-			buffer.resize(windowSize);
+		bool isEmpty() const noexcept
+		{
+			return numSpans == 0;
+		}
 
-			phasor.prepare(1. / Fs);
+		/* lo, hi */
+		void add(int lo, int hi) noexcept
+		{
+			if (lo >= hi)
+				return;
+
+			auto i = numSpans;
+			for (; i > 0 && spans[i - 1].lo > lo; --i)
+				spans[i] = spans[i - 1];
+			spans[i] = { lo, hi };
+			++numSpans;
+
+			auto n = 0;
+			for (auto j = 1; j < numSpans; ++j)
+				if (spans[j].lo <= spans[n].hi)
+					spans[n].hi = std::max(spans[n].hi, spans[j].hi);
+				else
+					spans[++n] = spans[j];
+			numSpans = n + 1;
+
+			if (numSpans <= MaxSpans)
+				return;
+			auto k = 0;
+			for (auto j = 1; j < numSpans - 1; ++j)
+				if (spans[j + 1].lo - spans[j].hi < spans[k + 1].lo - spans[k].hi)
+					k = j;
+			spans[k].hi = spans[k + 1].hi;
+			for (auto j = k + 1; j < numSpans - 1; ++j)
+				spans[j] = spans[j + 1];
+			--numSpans;
 		}
 
-		void operator()(const float** samples, int numChannels, int numSamples,
-			const PlayHeadPos& playHead) noexcept
-		{	
-			wHead(numSamples);
-			
-			const auto rateSyncV = 1.;
+		/* other */
+		void add(const OscopeSpans& other) noexcept
+		{
+			for (const auto& span : other)
+				add(span.lo, span.hi);
+		}
 
-			const auto bpm = playHead.bpm;
-			const auto bps = bpm * .0166666667;
-			const auto quarterNoteLengthInSamples = Fs / bps;
-			const auto barLengthInSamples = quarterNoteLengthInSamples * 4.;
-			const auto beatLen = barLengthInSamples * rateSyncV;
-			phasor.inc = 1. / beatLen;
-			beatLength.store(static_cast<float>(beatLen));
-			
-			const auto ppq = playHead.ppqPosition * .25;
-			const auto ppqCh = ppq / rateSyncV;
+		const Span* begin() const noexcept
+		{
+			return spans.data();
+		}
 
-			phasor.phase.phase = ppqCh - std::floor(ppqCh);
+		const Span* end() const noexcept
+		{
+			return spans.data() + numSpans;
+		}
 
-			for (auto s = 0; s < numSamples; ++s)
+	protected:
+		// one extra for the span that gets merged
+		std::array<Span, MaxSpans + 1> spans;
+		int numSpans;
+	};
+
+	// min/max pyramid of the oscilloscope's window.
+	// level 0 has bins of BaseBinSize samples, every next level halves the number of bins.
+	struct OscopePyramid
+	{
+		static constexpr int BaseBinSize = 4;
+		static constexpr int MinNumBins = 16;
+
+		OscopePyramid() :
+			mins(),
+			maxs(),
+			offsets(),
+			windowLength(0),
+			changed(),
+			beatLength(1.f)
+		{}
+
+		/* windowLength */
+		void prepare(int _windowLength)
+		{
+			windowLength = _windowLength;
+			offsets.clear();
+
+			auto size = 0;
+			auto numBins = getNumBins(windowLength, 0);
+			for (auto l = 0; l == 0 || numBins > MinNumBins; ++l)
+			{
+				numBins = getNumBins(windowLength, l);
+				offsets.push_back(size);
+				size += numBins;
+			}
+			offsets.push_back(size);
+
+			mins.assign(size, 0.f);
+			maxs.assign(size, 0.f);
+		}
+
+		int getNumLevels() const noexcept
+		{
+			return static_cast<int>(offsets.size()) - 1;
+		}
+
+		/* level */
+		int getNumBins(int l) const noexcept
+		{
+			return offsets[l + 1] - offsets[l];
+		}
+
+		/* level */
+		static int getBinSize(int l) noexcept
+		{
+			return BaseBinSize << l;
+		}
+
+		/* level */
+		const float* getMin(int l) const noexcept
+		{
+			return mins.data() + offsets[l];
+		}
+
+		/* level */
+		const float* getMax(int l) const noexcept
+		{
+			return maxs.data() + offsets[l];
+		}
+
+		/* raw, lo, hi
+		rebuilds every bin that contains a sample in [lo, hi) */
+		void update(const float* raw, int lo, int hi) noexcept
+		{
+			auto b0 = lo / BaseBinSize;
+			auto b1 = (hi + BaseBinSize - 1) / BaseBinSize;
 			{
-				auto w = wHead[s];
-				
-				const auto phaseInfo = phasor();
-				if (phaseInfo.retrig)
+				auto mn = mins.data();
+				auto mx = maxs.data();
+				for (auto b = b0; b < b1; ++b)
 				{
-					wHead.shift(-w, numSamples);
-					w = wHead[s];
+					const auto s0 = b * BaseBinSize;
+					const auto s1 = std::min(s0 + BaseBinSize, windowLength);
+					auto bMin = raw[s0];
+					auto bMax = raw[s0];
+					for (auto s = s0 + 1; s < s1; ++s)
+					{
+						bMin = std::min(bMin, raw[s]);
+						bMax = std::max(bMax, raw[s]);
+					}
+					mn[b] = bMin;
+					mx[b] = bMax;
 				}
-
-				buffer[w] = samples[0][s];
 			}
-			
-			if (numChannels == 2)
+
+			for (auto l = 1; l < getNumLevels(); ++l)
 			{
-				for (auto s = 0; s < numSamples; ++s)
+				const auto numChildren = getNumBins(l - 1);
+				const auto childMin = mins.data() + offsets[l - 1];
+				const auto childMax = maxs.data() + offsets[l - 1];
+				auto mn = mins.data() + offsets[l];
+				auto mx = maxs.data() + offsets[l];
+
+				b0 = b0 / 2;
+				b1 = (b1 + 1) / 2;
+				for (auto b = b0; b < b1; ++b)
 				{
-					const auto w = wHead[s];
-					buffer[w] = (buffer[w] + samples[1][s]) * .5f;
+					const auto c0 = b * 2;
+					const auto c1 = std::min(c0 + 1, numChildren - 1);
+					mn[b] = std::min(childMin[c0], childMin[c1]);
+					mx[b] = std::max(childMax[c0], childMax[c1]);
 				}
 			}
 		}
 
+		std::vector<float> mins, maxs;
+		std::vector<int> offsets;
+		int windowLength;
+		// the samples that changed since the pyramid the gui acquired before this one
+		OscopeSpans changed;
+		float beatLength;
+	protected:
+		/* windowLength, level */
+		static int getNumBins(int length, int l) noexcept
+		{
+			const auto binSize = getBinSize(l);
+			return (length + binSize - 1) / binSize;
+		}
+	};
+
+	// the audio thread writes the window and publishes its min/max pyramid through a
+	// lock-free triple buffer, so the gui always reads a complete one.
+	// the window is a ring that restarts at 0 on every bar, blocks are copied in spans between the restarts.
+	struct Oscilloscope
+	{
+		static constexpr int NumBuffers = 3;
+		static constexpr int NewBit = 4;
+		static constexpr int IdxMask = 3;
+
+		Oscilloscope() :
+			ring(),
+			phasor(0.),
+			pyramids(),
+			dirty(),
+			written(),
+			unseen(),
+			beatLength(1.f),
+			Fs(0.),
+			backIdx(0),
+			middleIdx(1),
+			frontIdx(2)
+		{}
+
+		void prepare(double sampleRate, int)
+		{
+			Fs = sampleRate;
+
+			ring.prepare(1, static_cast<int>(Fs) * 4);
+			const auto windowSize = ring.getCapacity();
+
+			for (auto& pyramid : pyramids)
+				pyramid.prepare(windowSize);
+			for (auto& d : dirty)
+			{
+				d.clear();
+				d.add(0, windowSize);
+			}
+			unseen.clear();
+			unseen.add(0, windowSize);
+
+			phasor.prepare(1. / Fs);
+		}
+
+		void operator()(const float** samples, int numChannels, int numSamples,
+			const PlayHeadPos& playHead) noexcept
+		{
+			const auto smplsR = numChannels == 2 ? samples[1] : nullptr;
+			process(samples[0], smplsR, numSamples, playHead);
+		}
+
 		void operator()(const float* samples, int numSamples,
 			const PlayHeadPos& playHead) noexcept
 		{
-			wHead(numSamples);
+			process(samples, nullptr, numSamples, playHead);
+		}
+
+		/* called by the gui, returns the most recently published pyramid.
+		it stays valid and unchanged until the next call. */
+		const OscopePyramid& acquire() const noexcept
+		{
+			if (middleIdx.load(std::memory_order_relaxed) & NewBit)
+				frontIdx = middleIdx.exchange(frontIdx, std::memory_order_acq_rel) & IdxMask;
+			return pyramids[frontIdx];
+		}
+
+		/* called by the gui, true if a pyramid was published since the last acquire */
+		bool isUpdated() const noexcept
+		{
+			return (middleIdx.load(std::memory_order_relaxed) & NewBit) != 0;
+		}
 
+		const float getBeatLength() const noexcept
+		{
+			return beatLength.load();
+		}
+	protected:
+		RingBuffer ring;
+		Phasor<double> phasor;
+		std::array<OscopePyramid, NumBuffers> pyramids;
+		// the samples each pyramid missed since it was last updated
+		std::array<OscopeSpans, NumBuffers> dirty;
+		// the samples written in this block
+		OscopeSpans written;
+		// the samples written since the last pyramid the gui acquired
+		OscopeSpans unseen;
+		std::atomic<float> beatLength;
+		double Fs;
+		int backIdx;
+		mutable std::atomic<int> middleIdx;
+		mutable int frontIdx;
+
+		/* smplsL, smplsR (or nullptr), numSamples, playHead */
+		void process(const float* smplsL, const float* smplsR, int numSamples,
+			const PlayHeadPos& playHead) noexcept
+		{
 			const auto rateSyncV = 1.;
 
 			const auto bpm = playHead.bpm;
@@ -90,40 +322,71 @@ namespace audio
 
 			phasor.phase.phase = ppqCh - std::floor(ppqCh);
 
-			for (auto s = 0; s < numSamples; ++s)
-			{
-				auto w = wHead[s];
+			written.clear();
 
-				const auto phaseInfo = phasor();
-				if (phaseInfo.retrig)
+			// every retrig writes the rest of the block from the start of the window
+			auto s0 = 0;
+			for (auto s = 0; s < numSamples; ++s)
+				if (phasor().retrig)
 				{
-					wHead.shift(-w, numSamples);
-					w = wHead[s];
+					write(smplsL, smplsR, s0, s - s0);
+					ring.setWritePos(0);
+					s0 = s;
 				}
+			write(smplsL, smplsR, s0, numSamples - s0);
 
-				buffer[w] = samples[s];
-			}
+			publish();
 		}
 
-		const float* data() const noexcept
+		/* smplsL, smplsR (or nullptr), startIdx, numSamples */
+		void write(const float* smplsL, const float* smplsR, int s, int numSamples) noexcept
 		{
-			return buffer.data();
+			if (numSamples == 0)
+				return;
+
+			const auto spans = ring.getSpans(ring.getWritePos(), numSamples);
+			auto buf = ring.getWritePointer(0);
+			writeSpan(buf + spans.idx, smplsL + s, smplsR == nullptr ? nullptr : smplsR + s, spans.len0);
+			written.add(spans.idx, spans.idx + spans.len0);
+			if (spans.len1 != 0)
+			{
+				s += spans.len0;
+				writeSpan(buf, smplsL + s, smplsR == nullptr ? nullptr : smplsR + s, spans.len1);
+				written.add(0, spans.len1);
+			}
+			ring.advance(numSamples);
 		}
-		
-		const size_t windowLength() const noexcept
+
+		/* dest, smplsL, smplsR (or nullptr), numSamples */
+		static void writeSpan(float* dest, const float* smplsL, const float* smplsR, int numSamples) noexcept
 		{
-			return buffer.size();
+			SIMD::copy(dest, smplsL, numSamples);
+			if (smplsR == nullptr)
+				return;
+			SIMD::add(dest, smplsR, numSamples);
+			SIMD::multiply(dest, .5f, numSamples);
 		}
 
-		const float getBeatLength() const noexcept
+		void publish() noexcept
 		{
-			return beatLength.load();
+			for (auto& d : dirty)
+				d.add(written);
+
+			auto& back = pyramids[backIdx];
+			auto& d = dirty[backIdx];
+			for (const auto& span : d)
+				back.update(ring.getReadPointer(0), span.lo, span.hi);
+			back.beatLength = beatLength.load();
+			d.clear();
+
+			unseen.add(written);
+			back.changed = unseen;
+
+			const auto prev = middleIdx.exchange(backIdx | NewBit, std::memory_order_acq_rel);
+			backIdx = prev & IdxMask;
+			// if the gui took the previous pyramid, it only misses what this one adds
+			if ((prev & NewBit) == 0)
+				unseen = written;
 		}
-	protected:
-		WHead wHead;
-		std::vector<float> buffer;
-		Phasor<double> phasor;
-		std::atomic<float> beatLength;
-		double Fs;
 	};
-}
\ No newline at end of file
+}
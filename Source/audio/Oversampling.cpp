@@ -1,199 +1,261 @@
 #include "Oversampling.h"
 #include <cmath>
+#include <complex>
+#include <cstring>
 
 namespace audio
 {
-	// ImpulseResponse
+	using Complex = std::complex<double>;
+	static constexpr double PiD = 3.14159265358979323846;
 
-	ImpulseResponse::ImpulseResponse(const std::vector<float>& _buf) :
-		buf(_buf),
-		latency(static_cast<int>(size()) / 2)
+	/* data, inverse
+	radix 2 fft in place, the inverse is scaled by 1 / size */
+	static void fft(std::vector<Complex>& data, bool inverse)
 	{
-	}
+		const auto size = static_cast<int>(data.size());
+		for (auto i = 1, j = 0; i < size; ++i)
+		{
+			auto bit = size >> 1;
+			for (; (j & bit) != 0; bit >>= 1)
+				j ^= bit;
+			j ^= bit;
+			if (i < j)
+				std::swap(data[i], data[j]);
+		}
 
-	ImpulseResponse::ImpulseResponse(const ImpulseResponse& other) :
-		buf(other.buf),
-		latency(other.latency)
-	{
+		for (auto len = 2; len <= size; len <<= 1)
+		{
+			const auto angle = (inverse ? 2. : -2.) * PiD / static_cast<double>(len);
+			const Complex wLen(std::cos(angle), std::sin(angle));
+			const auto half = len / 2;
+			for (auto i = 0; i < size; i += len)
+			{
+				Complex w(1.);
+				for (auto j = 0; j < half; ++j)
+				{
+					const auto u = data[i + j];
+					const auto v = data[i + j + half] * w;
+					data[i + j] = u + v;
+					data[i + j + half] = u - v;
+					w *= wLen;
+				}
+			}
+		}
+
+		if (inverse)
+			for (auto& d : data)
+				d /= static_cast<double>(size);
 	}
 
-	void ImpulseResponse::operator=(const std::vector<float>& _buf)
+	/* transition width, relative to the stage's sample rate
+	half-band windowed sinc with a blackman window, centred on a quarter of the sample rate.
+	every second tap is 0, except the centre one */
+	static std::vector<double> makeHalfBand(double transition)
 	{
-		buf = _buf;
-		latency = static_cast<int>(_buf.size()) / 2;
+		// the centre is on an odd index, so that the sinc taps are the even ones
+		const auto M = static_cast<int>(std::ceil(3. / transition)) | 1;
+		const auto N = 2 * M + 1;
+		const auto NInv = 1. / static_cast<double>(N - 1);
+
+		std::vector<double> ir(N, 0.);
+		auto sum = 0.;
+		for (auto n = 0; n < N; ++n)
+		{
+			const auto k = n - M;
+			if (k != 0 && k % 2 == 0)
+				continue;
+
+			const auto sinc = k == 0 ? .5 : std::sin(.5 * PiD * k) / (PiD * k);
+			const auto x = static_cast<double>(n) * NInv;
+			const auto window = .42 - .5 * std::cos(2. * PiD * x) + .08 * std::cos(4. * PiD * x);
+			ir[n] = sinc * window;
+			sum += ir[n];
+		}
+
+		for (auto& h : ir)
+			h /= sum;
+		return ir;
 	}
 
-	float ImpulseResponse::operator[](int i) const noexcept
+	/* impulse response
+	returns the minimum phase filter with the same magnitude response, from the real cepstrum */
+	static std::vector<double> makeMinimumPhase(const std::vector<double>& ir)
 	{
-		return buf[i];
+		const auto N = static_cast<int>(ir.size());
+		const auto size = juce::nextPowerOfTwo(N * 32);
+		std::vector<Complex> x(size, 0.);
+		for (auto n = 0; n < N; ++n)
+			x[n] = ir[n];
+
+		fft(x, false);
+		for (auto& v : x)
+			v = std::log(std::max(std::abs(v), 1e-9));
+		fft(x, true);
+
+		// the anticausal part of the cepstrum is folded onto the causal one
+		x[0] = x[0].real();
+		for (auto n = 1; n < size / 2; ++n)
+			x[n] = 2. * x[n].real();
+		x[size / 2] = x[size / 2].real();
+		for (auto n = size / 2 + 1; n < size; ++n)
+			x[n] = 0.;
+
+		fft(x, false);
+		for (auto& v : x)
+			v = std::exp(v);
+		fft(x, true);
+
+		std::vector<double> y(N);
+		for (auto n = 0; n < N; ++n)
+			y[n] = x[n].real();
+		return y;
 	}
 
-	const size_t ImpulseResponse::size() const noexcept
+	/* impulse response, returns the group delay at dc in samples */
+	static double getGroupDelay(const std::vector<double>& ir)
 	{
-		return buf.size();
+		auto weighted = 0., sum = 0.;
+		for (auto n = 0; n < static_cast<int>(ir.size()); ++n)
+		{
+			weighted += static_cast<double>(n) * ir[n];
+			sum += ir[n];
+		}
+		return sum == 0. ? 0. : weighted / sum;
 	}
 
-	const int ImpulseResponse::getLatency() const noexcept
+	// OversamplingStage::Branch
+
+	void OversamplingStage::Branch::prepare(const std::vector<float>& ir, int phase, float gain, int extraDelay)
 	{
-		return latency;
+		h.clear();
+		for (auto i = phase; i < static_cast<int>(ir.size()); i += 2)
+			h.push_back(ir[i] * gain);
+
+		// taps below -160db at the edges are left out, leading ones become a delay
+		static constexpr float Eps = 1e-8f;
+		auto first = 0;
+		while (first < static_cast<int>(h.size()) && std::abs(h[first]) < Eps)
+			++first;
+		auto last = static_cast<int>(h.size());
+		while (last > first && std::abs(h[last - 1]) < Eps)
+			--last;
+		h = std::vector<float>(h.begin() + first, h.begin() + last);
+		delay = first + extraDelay;
 	}
 
-	const float* ImpulseResponse::data() const noexcept
+	int OversamplingStage::Branch::getHistory() const noexcept
 	{
-		return buf.data();
+		return h.empty() ? 0 : delay + static_cast<int>(h.size()) - 1;
 	}
 
-	/////////////////////////////////////////////////////
-
-	/*
-	* Fs,fc,bw,upsampling
-	Nyquist == Fs / 2
-	fc < Nyquist
-	bw < Nyquist
-	fc + bw < Nyquist
-	*/
-	static std::vector<float> makeWindowedSinc(float Fs, float fc, float bw, bool upsampling)
+	void OversamplingStage::Branch::operator()(float* dest, const float* x, int numSamples, bool add) const noexcept
 	{
-		const auto nyquist = Fs * .5f;
-		if (fc > nyquist || bw > nyquist || fc + bw > nyquist)
-			return {};
-
-		fc /= Fs;
-		bw /= Fs;
-
-		int M = static_cast<int>(4.f / bw);
-		if (M % 2 != 0)
-			M += 1; // M is even number
-
-		const auto Mf = static_cast<float>(M);
-		const auto MHalf = Mf * .5f;
-		const float MInv = 1.f / Mf;
-
-		const int N = M + 1;
-
-		const auto h = [&](float i)
-		{ // sinc
-			i -= MHalf;
-			if (i != 0.f)
-				return std::sin(Tau * fc * i) / i;
-			return Tau * fc;
-		};
-
-		const auto w = [&, tau2 = Tau * 2.f](float i)
-		{ // blackman window
-			i *= MInv;
-			return .42f - .5f * std::cos(Tau * i) + .08f * std::cos(tau2 * i);
-		};
-
-		std::vector<float> ir;
-		ir.reserve(N);
-		for (auto n = 0; n < N; ++n)
+		const auto numTaps = static_cast<int>(h.size());
+		if (numTaps == 0)
 		{
-			auto nF = static_cast<float>(n);
-			ir.emplace_back(h(nF) * w(nF));
+			if (!add)
+				SIMD::clear(dest, numSamples);
+			return;
 		}
 
-		const auto targetGain = upsampling ? 2.f : 1.f;
-		auto sum = 0.f; // normalize
-		for (const auto n : ir)
-			sum += n;
-		const auto sumInv = targetGain / sum;
-		for (auto& n : ir)
-			n *= sumInv;
-
-		return ir;
-	}
-
-	/*
-	* Fs,fc,upsampling
-	Nyquist == Fs / 2
-	fc < Nyquist
-	*/
-	static std::vector<float> makeWindowedSinc(float Fs, float fc, bool upsampling)
-	{
-		return makeWindowedSinc(Fs, fc, Fs * .25f - fc - 1.f, upsampling);
+		const auto src = x - delay;
+		if (add)
+			SIMD::addWithMultiply(dest, src, h[0], numSamples);
+		else
+			SIMD::multiply(dest, src, h[0], numSamples);
+		for (auto i = 1; i < numTaps; ++i)
+			SIMD::addWithMultiply(dest, src - i, h[i], numSamples);
 	}
 
-	// Convolver
+	// OversamplingStage::LinearBuffer
 
-	Convolver::Convolver(const ImpulseResponse& _ir, const WHead& _wHead) :
-		ring(),
-		ir(_ir),
-		wHead(_wHead),
-		irSize(0)
+	void OversamplingStage::LinearBuffer::prepare(int numChannels, int _history, int blockSize)
 	{
+		history = _history;
+		buffer.setSize(numChannels, history + blockSize, false, true, false);
 	}
 
-	void Convolver::prepare()
+	float* OversamplingStage::LinearBuffer::getBlock(int ch) noexcept
 	{
-		irSize = static_cast<int>(ir.size());
-		ring.setSize(2 + (PPDHasSidechain ? 2 : 0), irSize, false, true, false);
+		return buffer.getWritePointer(ch) + history;
 	}
 
-	void Convolver::processBlock(float* const* samples, int numChannels, int numSamples) noexcept
+	void OversamplingStage::LinearBuffer::shift(int ch, int numSamples) noexcept
 	{
-		for (auto ch = 0; ch < numChannels; ++ch)
-		{
-			auto smpls = samples[ch];
-			auto rng = ring.getWritePointer(ch);
-
-			processBlock(smpls, rng, numSamples);
-		}
+		auto buf = buffer.getWritePointer(ch);
+		std::memmove(buf, buf + numSamples, sizeof(float) * static_cast<size_t>(history));
 	}
 
-	void Convolver::processBlock(float* smpls, float* rng, int numSamples) noexcept
+	// OversamplingStage
+
+	OversamplingStage::OversamplingStage() :
+		upEven(),
+		upOdd(),
+		downEven(),
+		downOdd(),
+		upBuf(),
+		downEvenBuf(),
+		downOddBuf(),
+		evenBuf(),
+		oddBuf()
 	{
-		for (auto s = 0; s < numSamples; ++s)
-			smpls[s] = processSample(smpls[s], rng, wHead[s]);
 	}
 
-	float Convolver::processSample(float smpl, float* rng, int w) noexcept
+	void OversamplingStage::prepare(const std::vector<float>& ir, int numChannels, int blockSize, int extraDelay)
 	{
-		rng[w] = smpl;
-
-		auto y = 0.f;
-		auto r = w;
-
-		for (auto i = 0; i < irSize; ++i)
-		{
-			y += rng[r] * ir[i];
-			--r;
-			if (r == -1)
-				r = irSize - 1;
-		}
-
-		return y;
+		// upsampling: y[2n + p] = sum_i 2 * h[2i + p] * x[n - i]
+		upEven.prepare(ir, 0, 2.f, 0);
+		upOdd.prepare(ir, 1, 2.f, 0);
+		// downsampling: y[n] = sum_i h[2i] * v[2(n - i)] + h[2i + 1] * v[2(n - i - 1) + 1]
+		downEven.prepare(ir, 0, 1.f, extraDelay);
+		downOdd.prepare(ir, 1, 1.f, extraDelay + 1);
+
+		upBuf.prepare(numChannels, std::max(upEven.getHistory(), upOdd.getHistory()), blockSize);
+		downEvenBuf.prepare(numChannels, downEven.getHistory(), blockSize);
+		downOddBuf.prepare(numChannels, downOdd.getHistory(), blockSize);
+		evenBuf.resize(blockSize);
+		oddBuf.resize(blockSize);
 	}
 
-	/////////////////////////////////////////////////////
-	
-	/* samplesUp, samplesIn, numChannels, numSamples1x */
-	static void zeroStuff(float* const* samplesUp, const float* const* samplesIn, int numChannels, int numSamples1x) noexcept
+	void OversamplingStage::upsample(float* const* samplesUp, const float* const* samplesIn, int numChannels, int numSamples) noexcept
 	{
+		auto even = evenBuf.data();
+		auto odd = oddBuf.data();
 		for (auto ch = 0; ch < numChannels; ++ch)
 		{
-			auto upBuf = samplesUp[ch];
-			const auto inBuf = samplesIn[ch];
-
-			for (auto s = 0; s < numSamples1x; ++s)
+			auto x = upBuf.getBlock(ch);
+			SIMD::copy(x, samplesIn[ch], numSamples);
+			upEven(even, x, numSamples, false);
+			upOdd(odd, x, numSamples, false);
+			upBuf.shift(ch, numSamples);
+
+			auto up = samplesUp[ch];
+			for (auto s = 0; s < numSamples; ++s)
 			{
-				const auto s2 = s * 2;
-				upBuf[s2] = inBuf[s];
-				upBuf[s2 + 1] = 0.f;
+				up[2 * s] = even[s];
+				up[2 * s + 1] = odd[s];
 			}
 		}
 	}
 
-	/* samplesOut, samplesUp, numChannels, numSamples1x */
-	static void decimate(float* const* samplesOut, const float* const* samplesUp, int numChannels, int numSamples1x) noexcept
+	void OversamplingStage::downsample(float* const* samplesOut, const float* const* samplesUp, int numChannels, int numSamples) noexcept
 	{
 		for (auto ch = 0; ch < numChannels; ++ch)
 		{
-			auto outBuf = samplesOut[ch];
-			const auto upBuf = samplesUp[ch];
+			auto even = downEvenBuf.getBlock(ch);
+			auto odd = downOddBuf.getBlock(ch);
+			const auto up = samplesUp[ch];
+			for (auto s = 0; s < numSamples; ++s)
+			{
+				even[s] = up[2 * s];
+				odd[s] = up[2 * s + 1];
+			}
 
-			for (auto s = 0; s < numSamples1x; ++s)
-				outBuf[s] = upBuf[s * 2];
+			auto out = samplesOut[ch];
+			downEven(out, even, numSamples, false);
+			downOdd(out, odd, numSamples, true);
+			downEvenBuf.shift(ch, numSamples);
+			downOddBuf.shift(ch, numSamples);
 		}
 	}
 
@@ -203,64 +265,87 @@ namespace audio
 		Fs(0.),
 		blockSize(0),
 
-		buffer(),
-
-		irUp(),
-		irDown(),
-		wHead(),
-
-		filterUp(irUp, wHead),
-		filterDown(irDown, wHead),
+		buffers(),
+		stages(),
 
 		FsUp(0.),
 		blockSizeUp(0),
 
-		numSamples1x(0), numSamples2x(0),
+		numSamples1x(0),
+		latency(0.f),
 
+		order(1),
 		enabled(true),
-		enbld(false)
+		minPhase(false),
+		enbld(false),
+		ordr(1)
 	{
 	}
 
 	Oversampler::Oversampler(Oversampler& other) :
 		Fs(other.Fs),
 		blockSize(other.blockSize),
-		buffer(other.buffer),
-		irUp(other.irUp),
-		irDown(other.irDown),
-		wHead(other.wHead),
-		filterUp(irUp, wHead),
-		filterDown(irDown, wHead),
+		buffers(other.buffers),
+		stages(other.stages),
 		FsUp(other.FsUp),
 		blockSizeUp(other.blockSizeUp),
 		numSamples1x(other.numSamples1x),
-		numSamples2x(other.numSamples2x),
+		latency(other.latency),
+		order(other.order.load()),
 		enabled(other.enabled.load()),
-		enbld(other.enbld)
+		minPhase(other.minPhase.load()),
+		enbld(other.enbld),
+		ordr(other.ordr)
 	{}
 
 	void Oversampler::prepare(const double sampleRate, const int _blockSize)
 	{
 		enbld = isEnabled();
+		ordr = getOrder();
 
 		Fs = sampleRate;
 		blockSize = _blockSize;
+		latency = 0.f;
 
 		if (enbld)
 		{
 			const auto numChannels = 2 + (PPDHasSidechain ? 2 : 0);
+			const auto fc = std::min(static_cast<double>(CutoffFreq), Fs * .45);
+			const auto minPhs = isMinimumPhase();
 
-			FsUp = Fs * 2.;
-			blockSizeUp = blockSize * 2;
+			// every stage passes up to fc and rejects the images of the stage before it
+			std::array<std::vector<double>, MaxOrder> irs;
+			auto FsStage = Fs;
+			for (auto k = 0; k < ordr; ++k)
+			{
+				FsStage *= 2.;
+				irs[k] = makeHalfBand(2. * (.25 - fc / FsStage));
+				if (minPhs)
+					irs[k] = makeMinimumPhase(irs[k]);
+				// up and down each delay by the stage's delay at twice the rate of the stage's input
+				const auto delay = minPhs ? getGroupDelay(irs[k]) : static_cast<double>(irs[k].size() / 2);
+				latency += static_cast<float>(delay / static_cast<double>(1 << k));
+			}
 
-			irUp = makeWindowedSinc(static_cast<float>(FsUp), 19000.f, true);
-			irDown = makeWindowedSinc(static_cast<float>(FsUp), 19000.f, false);
+			// the half-band stages above 2x delay by fractions of a sample,
+			// the last downsampler pads the linear phase latency to a whole one
+			auto padding = 0;
+			if (!minPhs)
+			{
+				const auto scale = static_cast<float>(1 << (ordr - 1));
+				padding = static_cast<int>(std::round((std::ceil(latency) - latency) * scale));
+				latency = std::ceil(latency);
+			}
 
-			filterUp.prepare();
-			filterDown.prepare();
+			for (auto k = 0; k < ordr; ++k)
+			{
+				const auto extraDelay = k == ordr - 1 ? padding : 0;
+				stages[k].prepare(std::vector<float>(irs[k].begin(), irs[k].end()), numChannels, blockSize << k, extraDelay);
+				buffers[k].setSize(numChannels, blockSize << (k + 1), false, true, false);
+			}
 
-			buffer.setSize(numChannels, blockSizeUp, false, true, false);
-			wHead.prepare(blockSizeUp, static_cast<int>(irDown.size()));
+			FsUp = Fs * static_cast<double>(1 << ordr);
+			blockSizeUp = blockSize << ordr;
 		}
 		else
 		{
@@ -271,49 +356,42 @@ namespace audio
 
 	AudioBuffer& Oversampler::upsample(AudioBuffer& inputBuffer) noexcept
 	{
-		enbld = isEnabled();
-		if (enbld)
-		{
-			numSamples1x = inputBuffer.getNumSamples();
-			numSamples2x = numSamples1x * 2;
-			const auto numChannels = inputBuffer.getNumChannels();
-
-			buffer.setSize(numChannels, numSamples2x, true, false, true);
+		if (!enbld)
+			return inputBuffer;
 
-			auto samplesUp = buffer.getArrayOfWritePointers();
-			const auto samplesIn = inputBuffer.getArrayOfReadPointers();
+		numSamples1x = inputBuffer.getNumSamples();
+		const auto numChannels = inputBuffer.getNumChannels();
 
-			wHead(numSamples2x);
-
-			zeroStuff(samplesUp, samplesIn, numChannels, numSamples1x);
-			filterUp.processBlock(samplesUp, numChannels, numSamples2x);
-
-			return buffer;
+		auto samplesIn = inputBuffer.getArrayOfReadPointers();
+		auto numSamples = numSamples1x;
+		for (auto k = 0; k < ordr; ++k)
+		{
+			auto& buffer = buffers[k];
+			buffer.setSize(numChannels, numSamples * 2, true, false, true);
+			stages[k].upsample(buffer.getArrayOfWritePointers(), samplesIn, numChannels, numSamples);
+			samplesIn = buffer.getArrayOfReadPointers();
+			numSamples *= 2;
 		}
 
-		return inputBuffer;
+		return buffers[ordr - 1];
 	}
 
 	void Oversampler::downsample(AudioBuffer& outputBuffer) noexcept
 	{
-		if (enbld)
+		if (!enbld)
+			return;
+
+		const auto numChannels = outputBuffer.getNumChannels();
+		for (auto k = ordr - 1; k >= 0; --k)
 		{
-			auto samplesUp = buffer.getArrayOfWritePointers();
-			auto samplesOut = outputBuffer.getArrayOfWritePointers();
-			const auto samplesUpConst = buffer.getArrayOfReadPointers();
-			const auto numChannels = outputBuffer.getNumChannels();
-
-			// filter 2x + decimating
-			filterDown.processBlock(samplesUp, numChannels, numSamples2x);
-			decimate(samplesOut, samplesUpConst, numChannels, numSamples1x);
+			auto samplesOut = k == 0 ? outputBuffer.getArrayOfWritePointers() : buffers[k - 1].getArrayOfWritePointers();
+			stages[k].downsample(samplesOut, buffers[k].getArrayOfReadPointers(), numChannels, numSamples1x << k);
 		}
 	}
 
 	const int Oversampler::getLatency() const noexcept
 	{
-		if (isEnabled())
-			return (irUp.getLatency() + irDown.getLatency()) / 2;
-		return 0;
+		return static_cast<int>(std::round(latency));
 	}
 
 	double Oversampler::getFsUp() const noexcept
@@ -336,4 +414,24 @@ namespace audio
 	{
 		enabled.store(e);
 	}
-}
\ No newline at end of file
+
+	void Oversampler::setOrder(int o) noexcept
+	{
+		order.store(juce::jlimit(1, MaxOrder, o));
+	}
+
+	int Oversampler::getOrder() const noexcept
+	{
+		return order.load();
+	}
+
+	void Oversampler::setMinimumPhase(bool e) noexcept
+	{
+		minPhase.store(e);
+	}
+
+	bool Oversampler::isMinimumPhase() const noexcept
+	{
+		return minPhase.load();
+	}
+}
@@ -1,79 +1,72 @@
 #pragma once
 #include "AudioUtils.h"
-#include "WHead.h"
 #include <array>
 #include <vector>
 
 namespace audio
 {
-	struct ImpulseResponse
+	// one 2x stage. the filter is split into its two polyphase branches, so that upsampling
+	// never multiplies the stuffed zeros and downsampling only computes the samples it keeps.
+	// every branch runs on a linear buffer that keeps its history in front of the block,
+	// so each tap is one SIMD multiply-add over the whole block, without wrapping.
+	struct OversamplingStage
 	{
-		ImpulseResponse(const std::vector<float> & = { 1.f });
+		OversamplingStage();
 
-		ImpulseResponse(const ImpulseResponse&);
+		/* impulse response with unity gain at dc, numChannels, blockSize at the lower rate,
+		extra delay of the downsampler at the lower rate */
+		void prepare(const std::vector<float>&, int, int, int);
 
-		void operator=(const std::vector<float>&);
+		/* samplesUp, samplesIn, numChannels, numSamples at the lower rate */
+		void upsample(float* const*, const float* const*, int, int) noexcept;
 
-		float operator[](int i) const noexcept;
-		
-		const size_t size() const noexcept;
+		/* samplesOut, samplesUp, numChannels, numSamples at the lower rate */
+		void downsample(float* const*, const float* const*, int, int) noexcept;
 
-		const int getLatency() const noexcept;
-
-		const float* data() const noexcept;
 	protected:
-		std::vector<float> buf;
-		int latency;
-	};
+		struct Branch
+		{
+			std::vector<float> h;
+			int delay;
 
-	/*
-	* Fs,fc,bw,upsampling
-	Nyquist == Fs / 2
-	fc < Nyquist
-	bw < Nyquist
-	fc + bw < Nyquist
-	*/
-	//std::vector<float> makeWindowedSinc(float, float, float, bool);
-
-	/*
-	* Fs,fc,upsampling
-	Nyquist == Fs / 2
-	fc < Nyquist
-	*/
-	//std::vector<float> makeWindowedSinc(float, float, bool);
-
-	struct Convolver
-	{
-		Convolver(const ImpulseResponse&, const WHead&);
+			/* impulse response, phase [0, 1], gain, extra delay */
+			void prepare(const std::vector<float>&, int, float, int);
 
-		void prepare();
+			/* samples before the block this branch reads */
+			int getHistory() const noexcept;
 
-		/* samples, numChannels, numSamples */
-		void processBlock(float* const*, int, int) noexcept;
+			/* dest, x, numSamples, add
+			x[-getHistory()] must be valid */
+			void operator()(float*, const float*, int, bool) const noexcept;
+		};
 
-	protected:
-		AudioBuffer ring;
-		const ImpulseResponse& ir;
-		const WHead& wHead;
-		int irSize;
-
-	private:
-		/*smpls,rng,numSamples*/
-		void processBlock(float*, float*, int) noexcept;
-		/*smpl,rng,w*/
-		float processSample(float, float*, int) noexcept;
-	};
+		// history followed by the block, per channel
+		struct LinearBuffer
+		{
+			AudioBuffer buffer;
+			int history;
+
+			/* numChannels, history, blockSize */
+			void prepare(int, int, int);
 
-	/* samplesUp, samplesIn, numChannels, numSamples1x */
-	//void zeroStuff(float* const*, const float**, int, int) noexcept;
+			/* ch, the first sample of the block */
+			float* getBlock(int) noexcept;
 
-	/* samplesOut, samplesUp, numChannels, numSamples1x */
-	//void decimate(float* const*, const float**, int, int) noexcept;
+			/* ch, numSamples, keeps the last samples as the next block's history */
+			void shift(int, int) noexcept;
+		};
+
+		Branch upEven, upOdd, downEven, downOdd;
+		LinearBuffer upBuf, downEvenBuf, downOddBuf;
+		std::vector<float> evenBuf, oddBuf;
+	};
 
 	class Oversampler
 	{
-		static constexpr float CutoffFreq = 18000.f;
+		static constexpr float CutoffFreq = 19000.f;
 	public:
+		static constexpr int MaxOrder = 3;
+
 		Oversampler();
 
 		Oversampler(Oversampler&);
@@ -88,32 +81,45 @@ namespace audio
 		void downsample(AudioBuffer&) noexcept;
 
 		const int getLatency() const noexcept;
-		
+
 		double getFsUp() const noexcept;
-		
+
 		int getBlockSizeUp() const noexcept;
 
 		bool isEnabled() const noexcept;
 
 		/* only call this if processor is suspended! */
 		void setEnabled(bool) noexcept;
+
+		/* order [1, MaxOrder], oversamples by 2^order.
+		only call this if processor is suspended! */
+		void setOrder(int) noexcept;
+
+		int getOrder() const noexcept;
+
+		/* trades the linear phase for less latency.
+		only call this if processor is suspended! */
+		void setMinimumPhase(bool) noexcept;
+
+		bool isMinimumPhase() const noexcept;
 	protected:
 		double Fs;
 		int blockSize;
 
-		AudioBuffer buffer;
-
-		ImpulseResponse irUp, irDown;
-		WHead wHead;
-		Convolver filterUp, filterDown;
+		// buffers[k] holds the signal at 2^(k + 1) times the sample rate
+		std::array<AudioBuffer, MaxOrder> buffers;
+		std::array<OversamplingStage, MaxOrder> stages;
 
 		double FsUp;
 		int blockSizeUp;
 
-		int numSamples1x, numSamples2x;
+		int numSamples1x;
+		float latency;
 
-		std::atomic<bool> enabled;
+		std::atomic<int> order;
+		std::atomic<bool> enabled, minPhase;
 		bool enbld;
+		int ordr;
 	};
 
-}
\ No newline at end of file
+}
@@ -25,6 +25,13 @@ namespace audio
 		return buf.data();
 	}
 
+	float* PRM::operator()(const float* values, int numSamples) noexcept
+	{
+		SIMD::copy(buf.data(), values, numSamples);
+		smooth.jumpTo(values[numSamples - 1]);
+		return buf.data();
+	}
+
 	float PRM::operator[](int i) const noexcept
 	{
 		return buf[i];
@@ -17,6 +17,10 @@ namespace audio
 		/* numSamples */
 		float* operator()(int) noexcept;
 
+		/* values, numSamples
+		takes the values as they are, the smoother continues from the last one */
+		float* operator()(const float*, int) noexcept;
+
 		/* idx */
 		float operator[](int) const noexcept;
 
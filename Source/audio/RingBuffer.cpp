@@ -0,0 +1,92 @@
+#include "RingBuffer.h"
+
+namespace audio
+{
+	RingBuffer::RingBuffer() :
+		buffer(),
+		capacity(1),
+		mask(0),
+		writePos(0)
+	{}
+
+	void RingBuffer::prepare(int numChannels, int minCapacity)
+	{
+		capacity = juce::nextPowerOfTwo(std::max(1, minCapacity));
+		mask = capacity - 1;
+		writePos = 0;
+		buffer.setSize(numChannels, capacity, false, true, false);
+	}
+
+	void RingBuffer::clear() noexcept
+	{
+		buffer.clear();
+		writePos = 0;
+	}
+
+	int RingBuffer::getCapacity() const noexcept
+	{
+		return capacity;
+	}
+
+	int RingBuffer::getWritePos() const noexcept
+	{
+		return writePos;
+	}
+
+	void RingBuffer::setWritePos(int pos) noexcept
+	{
+		writePos = wrap(pos);
+	}
+
+	void RingBuffer::advance(int numSamples) noexcept
+	{
+		writePos = wrap(writePos + numSamples);
+	}
+
+	int RingBuffer::wrap(int idx) const noexcept
+	{
+		return idx & mask;
+	}
+
+	RingBuffer::Spans RingBuffer::getSpans(int pos, int numSamples) const noexcept
+	{
+		const auto idx = wrap(pos);
+		const auto len0 = std::min(numSamples, capacity - idx);
+		return { idx, len0, numSamples - len0 };
+	}
+
+	void RingBuffer::write(int ch, const float* src, int numSamples) noexcept
+	{
+		const auto spans = getSpans(writePos, numSamples);
+		auto rng = buffer.getWritePointer(ch);
+		SIMD::copy(rng + spans.idx, src, spans.len0);
+		if (spans.len1 != 0)
+			SIMD::copy(rng, src + spans.len0, spans.len1);
+	}
+
+	void RingBuffer::write(const float* const* src, int numChannels, int numSamples) noexcept
+	{
+		for (auto ch = 0; ch < numChannels; ++ch)
+			write(ch, src[ch], numSamples);
+		advance(numSamples);
+	}
+
+	void RingBuffer::read(int ch, float* dest, int delay, int numSamples) const noexcept
+	{
+		const auto spans = getSpans(writePos - delay, numSamples);
+		const auto rng = buffer.getReadPointer(ch);
+		SIMD::copy(dest, rng + spans.idx, spans.len0);
+		if (spans.len1 != 0)
+			SIMD::copy(dest + spans.len0, rng, spans.len1);
+	}
+
+	const float* RingBuffer::getReadPointer(int ch) const noexcept
+	{
+		return buffer.getReadPointer(ch);
+	}
+
+	float* RingBuffer::getWritePointer(int ch) noexcept
+	{
+		return buffer.getWritePointer(ch);
+	}
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include "AudioUtils.h"
+
+namespace audio
+{
+	// multichannel ring buffer with a power of two capacity.
+	// positions wrap with a mask and a block is copied in at most two contiguous spans,
+	// so that writing and reading a block costs about as much as a memcpy.
+	struct RingBuffer
+	{
+		// the part of a block before the end of the ring, and the part that wraps to its start
+		struct Spans
+		{
+			int idx, len0, len1;
+		};
+
+		RingBuffer();
+
+		/* numChannels, minCapacity, not realtime safe.
+		the capacity is rounded up to the next power of two */
+		void prepare(int, int);
+
+		void clear() noexcept;
+
+		int getCapacity() const noexcept;
+
+		int getWritePos() const noexcept;
+
+		/* pos, wrapped into the ring */
+		void setWritePos(int) noexcept;
+
+		/* numSamples */
+		void advance(int) noexcept;
+
+		/* idx */
+		int wrap(int) const noexcept;
+
+		/* pos, numSamples [0, capacity] */
+		Spans getSpans(int, int) const noexcept;
+
+		/* ch, src, numSamples
+		writes at the write position without advancing it */
+		void write(int, const float*, int) noexcept;
+
+		/* src, numChannels, numSamples
+		writes every channel and advances the write position */
+		void write(const float* const*, int, int) noexcept;
+
+		/* ch, dest, delay, numSamples
+		reads numSamples, starting delay samples before the write position */
+		void read(int, float*, int, int) const noexcept;
+
+		const float* getReadPointer(int) const noexcept;
+
+		float* getWritePointer(int) noexcept;
+
+	protected:
+		AudioBuffer buffer;
+		int capacity, mask, writePos;
+	};
+}
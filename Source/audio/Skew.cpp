@@ -0,0 +1,152 @@
+#include "Skew.h"
+#include <juce_core/juce_core.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SkewHasX86 1
+#include <immintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+#define SkewTargetAVX2 __attribute__((target("avx2")))
+#else
+#define SkewTargetAVX2
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define SkewHasNEON 1
+#include <arm_neon.h>
+#endif
+
+namespace audio
+{
+	namespace skew
+	{
+		// the vector kernels do exactly the operations of the scalar one, in the same order,
+		// and replace the xy == 0 case with a mask instead of a branch.
+
+		static void processScalar(float* dest, const float* x, const float* bias, int numSamples) noexcept
+		{
+			for (auto s = 0; s < numSamples; ++s)
+				dest[s] = getSkewed(x[s], bias[s]);
+		}
+
+#if SkewHasX86
+		static void processSSE2(float* dest, const float* x, const float* bias, int numSamples) noexcept
+		{
+			const auto one = _mm_set1_ps(1.f);
+			const auto zero = _mm_setzero_ps();
+
+			auto s = 0;
+			for (; s + 4 <= numSamples; s += 4)
+			{
+				const auto xV = _mm_loadu_ps(x + s);
+				const auto b = _mm_loadu_ps(bias + s);
+				const auto b2 = _mm_add_ps(b, b);
+				const auto bM = _mm_sub_ps(one, b);
+				const auto xy = _mm_add_ps(_mm_sub_ps(bM, xV), _mm_mul_ps(b2, xV));
+				const auto y = _mm_div_ps(_mm_mul_ps(b, xV), xy);
+				const auto notZero = _mm_cmpneq_ps(xy, zero);
+				_mm_storeu_ps(dest + s, _mm_and_ps(y, notZero));
+			}
+
+			processScalar(dest + s, x + s, bias + s, numSamples - s);
+		}
+
+		SkewTargetAVX2
+		static void processAVX2(float* dest, const float* x, const float* bias, int numSamples) noexcept
+		{
+			const auto one = _mm256_set1_ps(1.f);
+			const auto zero = _mm256_setzero_ps();
+
+			auto s = 0;
+			for (; s + 8 <= numSamples; s += 8)
+			{
+				const auto xV = _mm256_loadu_ps(x + s);
+				const auto b = _mm256_loadu_ps(bias + s);
+				const auto b2 = _mm256_add_ps(b, b);
+				const auto bM = _mm256_sub_ps(one, b);
+				const auto xy = _mm256_add_ps(_mm256_sub_ps(bM, xV), _mm256_mul_ps(b2, xV));
+				const auto y = _mm256_div_ps(_mm256_mul_ps(b, xV), xy);
+				const auto notZero = _mm256_cmp_ps(xy, zero, _CMP_NEQ_UQ);
+				_mm256_storeu_ps(dest + s, _mm256_and_ps(y, notZero));
+			}
+
+			processScalar(dest + s, x + s, bias + s, numSamples - s);
+		}
+#endif
+
+#if SkewHasNEON
+		static void processNEON(float* dest, const float* x, const float* bias, int numSamples) noexcept
+		{
+			const auto one = vdupq_n_f32(1.f);
+			const auto zero = vdupq_n_f32(0.f);
+
+			auto s = 0;
+			for (; s + 4 <= numSamples; s += 4)
+			{
+				const auto xV = vld1q_f32(x + s);
+				const auto b = vld1q_f32(bias + s);
+				const auto b2 = vaddq_f32(b, b);
+				const auto bM = vsubq_f32(one, b);
+				const auto xy = vaddq_f32(vsubq_f32(bM, xV), vmulq_f32(b2, xV));
+				const auto y = vdivq_f32(vmulq_f32(b, xV), xy);
+				const auto isZero = vceqq_f32(xy, zero);
+				vst1q_f32(dest + s, vbslq_f32(isZero, zero, y));
+			}
+
+			processScalar(dest + s, x + s, bias + s, numSamples - s);
+		}
+#endif
+
+		const char* toString(Kernel k) noexcept
+		{
+			switch (k)
+			{
+			case Kernel::Scalar: return "Scalar";
+			case Kernel::SSE2: return "SSE2";
+			case Kernel::AVX2: return "AVX2";
+			case Kernel::NEON: return "NEON";
+			default: return "";
+			}
+		}
+
+		Func getKernel(Kernel k) noexcept
+		{
+			switch (k)
+			{
+			case Kernel::Scalar:
+				return &processScalar;
+#if SkewHasX86
+			case Kernel::SSE2:
+				return juce::SystemStats::hasSSE2() ? &processSSE2 : nullptr;
+			case Kernel::AVX2:
+				return juce::SystemStats::hasAVX2() ? &processAVX2 : nullptr;
+#endif
+#if SkewHasNEON
+			case Kernel::NEON:
+				return &processNEON;
+#endif
+			default:
+				return nullptr;
+			}
+		}
+
+		static Kernel pickBestKernel() noexcept
+		{
+			for (auto k : { Kernel::AVX2, Kernel::NEON, Kernel::SSE2 })
+				if (getKernel(k) != nullptr)
+					return k;
+			return Kernel::Scalar;
+		}
+
+		static const Kernel bestKernel = pickBestKernel();
+		static const Func bestFunc = getKernel(bestKernel);
+
+		Kernel getBestKernel() noexcept
+		{
+			return bestKernel;
+		}
+
+		void getSkewed(float* dest, const float* x, const float* bias, int numSamples) noexcept
+		{
+			bestFunc(dest, x, bias, numSamples);
+		}
+	}
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+namespace audio
+{
+	namespace skew
+	{
+		/* x [0,1], bias [0,1] */
+		inline float getSkewed(float x, float bias) noexcept
+		{
+			const auto b2 = bias + bias;
+			const auto bM = 1.f - bias;
+			const auto xy = bM - x + b2 * x;
+			if (xy == 0.f)
+				return 0.f;
+			return bias * x / xy;
+		}
+
+		enum class Kernel
+		{
+			Scalar,
+			SSE2,
+			AVX2,
+			NEON,
+			NumKernels
+		};
+
+		const char* toString(Kernel) noexcept;
+
+		/* dest, x, bias, numSamples */
+		using Func = void(*)(float*, const float*, const float*, int) noexcept;
+
+		/* returns nullptr if the kernel is not available on this machine */
+		Func getKernel(Kernel) noexcept;
+
+		/* the fastest available kernel, picked once at startup */
+		Kernel getBestKernel() noexcept;
+
+		/* dest, x, bias, numSamples
+		shapes a buffer of raw ramp values. dest may be x.
+		the output is bit-identical to the scalar getSkewed with every kernel. */
+		void getSkewed(float*, const float*, const float*, int) noexcept;
+	}
+}
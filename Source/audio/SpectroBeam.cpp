@@ -4,31 +4,58 @@ namespace audio
 {
 	template<size_t Order>
 	SpectroBeam<Order>::SpectroBeam() :
+		juce::Thread("SpectroBeam"),
 		smpls(),
+		fifoBuffer(),
+		fifo(1),
 		fft(Order),
-		fifo(),
-		window(),
-		buffer(),
-		ready(false),
-		idx(0)
+		history(Size, 0.f),
+		fftBuffer(Size2, 0.f),
+		window(Size),
+		magGain(1.f),
+		historyIdx(0),
+		hopIdx(0),
+		spectra(),
+		backIdx(0),
+		middleIdx(1),
+		frontIdx(2)
 	{
-		SIMD::clear(buffer.data(), Size2);
-		SIMD::clear(fifo.data(), Size2);
+		for (auto& spectrum : spectra)
+			spectrum.assign(NumBins, 0.f);
 
 		// gaussian window
+		auto sum = 0.f;
 		for (auto i = 0; i < Size; ++i)
 		{
 			const auto norm = static_cast<float>(i) * SizeInv;
 			const auto x = norm * 2.f - 1.f;
 			const auto w = std::exp(-x * x * 16.f);
 			window[i] = w;
+			sum += w;
 		}
+		// a full scale sine has a magnitude of 1
+		magGain = 2.f / sum;
+	}
+
+	template<size_t Order>
+	SpectroBeam<Order>::~SpectroBeam()
+	{
+		stopThread(PollIntervalMs * 100);
 	}
 
 	template<size_t Order>
 	void SpectroBeam<Order>::prepare(int blockSize)
 	{
+		stopThread(PollIntervalMs * 100);
+
 		smpls.resize(blockSize);
+		// room for the blocks of a few poll intervals, even at high sample rates
+		const auto fifoSize = std::max(static_cast<int>(Size), blockSize * 4) + 8192;
+		fifoBuffer.assign(fifoSize, 0.f);
+		fifo.setTotalSize(fifoSize);
+		fifo.reset();
+
+		startThread(juce::Thread::Priority::low);
 	}
 
 	template<size_t Order>
@@ -36,14 +63,10 @@ namespace audio
 	{
 		const auto chInv = 1.f / numChannels;
 
-		for (auto s = 0; s < numSamples; ++s)
-		{
-			auto mid = samples[0][s];
-			for (auto ch = 1; ch < numChannels; ++ch)
-				mid += samples[ch][s];
-			mid *= chInv;
-			smpls[s] = mid;
-		}
+		SIMD::copy(smpls.data(), samples[0], numSamples);
+		for (auto ch = 1; ch < numChannels; ++ch)
+			SIMD::add(smpls.data(), samples[ch], numSamples);
+		SIMD::multiply(smpls.data(), chInv, numSamples);
 
 		process(numSamples);
 	}
@@ -51,25 +74,95 @@ namespace audio
 	template<size_t Order>
 	void SpectroBeam<Order>::process(int numSamples) noexcept
 	{
-		auto fif = fifo.data();
-		for (auto s = 0; s < numSamples; ++s)
+		// if the worker falls behind, the samples that don't fit anymore are dropped
+		int start0, size0, start1, size1;
+		fifo.prepareToWrite(numSamples, start0, size0, start1, size1);
+		SIMD::copy(fifoBuffer.data() + start0, smpls.data(), size0);
+		if (size1 > 0)
+			SIMD::copy(fifoBuffer.data() + start1, smpls.data() + size0, size1);
+		fifo.finishedWrite(size0 + size1);
+	}
+
+	template<size_t Order>
+	const float* SpectroBeam<Order>::acquire() const noexcept
+	{
+		if (middleIdx.load(std::memory_order_relaxed) & NewBit)
+			frontIdx = middleIdx.exchange(frontIdx, std::memory_order_acq_rel) & IdxMask;
+		return spectra[frontIdx].data();
+	}
+
+	template<size_t Order>
+	bool SpectroBeam<Order>::isUpdated() const noexcept
+	{
+		return (middleIdx.load(std::memory_order_relaxed) & NewBit) != 0;
+	}
+
+	template<size_t Order>
+	void SpectroBeam<Order>::run()
+	{
+		while (!threadShouldExit())
 		{
-			fif[idx] = smpls[s];
-			++idx;
-			if (idx == Size)
+			const auto numReady = fifo.getNumReady();
+			if (numReady > 0)
 			{
-				const auto wndw = window.data();
-				auto buf = buffer.data();
-
-				SIMD::multiply(fif, wndw, Size);
-				fft.performRealOnlyForwardTransform(fif, true);
-				SIMD::copy(buf, fif, Size);
-				ready.store(true);
-				idx = 0;
+				int start0, size0, start1, size1;
+				fifo.prepareToRead(numReady, start0, size0, start1, size1);
+				analyse(fifoBuffer.data() + start0, size0);
+				if (size1 > 0)
+					analyse(fifoBuffer.data() + start1, size1);
+				fifo.finishedRead(size0 + size1);
 			}
+
+			wait(PollIntervalMs);
 		}
 	}
 
+	template<size_t Order>
+	void SpectroBeam<Order>::analyse(const float* samples, int numSamples) noexcept
+	{
+		const auto hop = static_cast<int>(HopSize);
+		const auto size = static_cast<int>(Size);
+
+		auto s = 0;
+		while (s < numSamples)
+		{
+			// the history is a ring of the last Size samples
+			const auto len = std::min({ numSamples - s, hop - hopIdx, size - historyIdx });
+			SIMD::copy(history.data() + historyIdx, samples + s, len);
+			s += len;
+			hopIdx += len;
+			historyIdx = (historyIdx + len) & (size - 1);
+
+			if (hopIdx != hop)
+				continue;
+			hopIdx = 0;
+
+			// unrolls the ring, the oldest sample first
+			auto buf = fftBuffer.data();
+			const auto tail = size - historyIdx;
+			SIMD::copy(buf, history.data() + historyIdx, tail);
+			SIMD::copy(buf + tail, history.data(), historyIdx);
+			SIMD::multiply(buf, window.data(), size);
+
+			fft.performRealOnlyForwardTransform(buf, true);
+
+			auto mags = spectra[backIdx].data();
+			for (auto b = 0; b < static_cast<int>(NumBins); ++b)
+			{
+				const auto re = buf[b * 2];
+				const auto im = buf[b * 2 + 1];
+				mags[b] = std::sqrt(re * re + im * im) * magGain;
+			}
+			publish();
+		}
+	}
+
+	template<size_t Order>
+	void SpectroBeam<Order>::publish() noexcept
+	{
+		backIdx = middleIdx.exchange(backIdx | NewBit, std::memory_order_acq_rel) & IdxMask;
+	}
+
 	template struct SpectroBeam<1>;
 	template struct SpectroBeam<2>;
 	template struct SpectroBeam<3>;
@@ -4,39 +4,68 @@
 
 namespace audio
 {
+	// the audio thread only copies its samples into a lock-free fifo.
+	// a worker thread takes them from there, performs windowed ffts every HopSize samples
+	// (75% overlap) and publishes the magnitude spectra through a lock-free triple buffer.
 	template<size_t Order>
-	struct SpectroBeam
+	struct SpectroBeam :
+		public juce::Thread
 	{
 		static constexpr size_t Size = 1 << Order;
 		static constexpr size_t Size2 = Size * 2;
 		static constexpr size_t SizeHalf = Size / 2;
+		static constexpr size_t NumBins = SizeHalf + 1;
+		static constexpr size_t HopSize = Size >= 4 ? Size / 4 : 1;
 		static constexpr float SizeF = static_cast<float>(Size);
 		static constexpr float SizeInv = 1.f / SizeF;
+		static constexpr int PollIntervalMs = 10;
+		static constexpr int NumBuffers = 3;
+		static constexpr int NewBit = 4;
+		static constexpr int IdxMask = 3;
 		
 		using FFT = juce::dsp::FFT;
-		using Fifo = std::array<float, Size>;
-		using Fifo2 = std::array<float, Size2>;
 
 		SpectroBeam();
 
-		/* blockSize */
+		~SpectroBeam();
+
+		/* blockSize, not realtime safe, (re)starts the worker */
 		void prepare(int);
 
 		/* samples, numChannels, numSamples */
 		void operator()(float**, int, int) noexcept;
 
-		/* numSamples */
+		/* numSamples, pushes the mono samples of the last call */
 		void process(int) noexcept;
 
+		/* called by the gui, returns the most recently published magnitude spectrum of NumBins bins.
+		it stays valid and unchanged until the next call. */
+		const float* acquire() const noexcept;
+
+		/* called by the gui, true if a spectrum was published since the last acquire */
+		bool isUpdated() const noexcept;
+
 	protected:
+		// audio thread
 		std::vector<float> smpls;
+		std::vector<float> fifoBuffer;
+		juce::AbstractFifo fifo;
+		// worker
 		FFT fft;
-		Fifo2 fifo;
-		Fifo window;
-	public:
-		Fifo2 buffer;
-		std::atomic<bool> ready;
-	protected:
-		int idx;
+		std::vector<float> history, fftBuffer, window;
+		float magGain;
+		int historyIdx, hopIdx;
+		// worker to gui
+		std::array<std::vector<float>, NumBuffers> spectra;
+		int backIdx;
+		mutable std::atomic<int> middleIdx;
+		mutable int frontIdx;
+
+		void run() override;
+
+		/* samples, numSamples */
+		void analyse(const float*, int) noexcept;
+
+		void publish() noexcept;
 	};
-}
\ No newline at end of file
+}
@@ -0,0 +1,174 @@
+#include "StageCurve.h"
+#include "../arch/FormulaParser2.h"
+#include "../arch/Interpolation.h"
+
+namespace audio
+{
+	StageCurve::StageCurve() :
+		tables(),
+		backIdx(0),
+		frontIdx(1),
+		middleIdx(2),
+		formula(),
+		points()
+	{
+		for (auto& table : tables)
+		{
+			table.lut.fill(0.f);
+			table.enabled = false;
+		}
+	}
+
+	bool StageCurve::setFormula(const String& txt)
+	{
+		fx::Parser parser;
+		if (!parser(txt))
+			return false;
+
+		static constexpr int NumValues = Size * Oversampling + 1;
+		std::vector<float> values(NumValues);
+		const auto inc = 1.f / static_cast<float>(NumValues - 1);
+		for (auto i = 0; i < NumValues; ++i)
+			values[i] = static_cast<float>(i) * inc;
+		parser(values.data(), values.data(), NumValues);
+
+		formula = txt;
+		points.clear();
+		bake(values);
+		return true;
+	}
+
+	bool StageCurve::setSpline(const Points& pts)
+	{
+		if (pts.size() < 2)
+			return false;
+
+		points = pts;
+		formula.clear();
+
+		const auto func = interpolate::polynomial::getFunc(points);
+		static constexpr int NumValues = Size * Oversampling + 1;
+		std::vector<float> values(NumValues);
+		const auto inc = 1.f / static_cast<float>(NumValues - 1);
+		for (auto i = 0; i < NumValues; ++i)
+			values[i] = func(static_cast<float>(i) * inc);
+
+		bake(values);
+		return true;
+	}
+
+	void StageCurve::clear()
+	{
+		formula.clear();
+		points.clear();
+		tables[backIdx].enabled = false;
+		publish();
+	}
+
+	void StageCurve::update() noexcept
+	{
+		if ((middleIdx.load() & NewBit) == 0)
+			return;
+		frontIdx = middleIdx.exchange(frontIdx) & IdxMask;
+	}
+
+	bool StageCurve::isEnabled() const noexcept
+	{
+		return tables[frontIdx].enabled;
+	}
+
+	float StageCurve::operator()(float x) const noexcept
+	{
+		const auto idx = juce::jlimit(0.f, 1.f, x) * static_cast<float>(Size);
+		return interpolate::lerp(tables[frontIdx].lut.data(), idx);
+	}
+
+	void StageCurve::operator()(float* dest, const float* x, int numSamples) const noexcept
+	{
+		const auto lut = tables[frontIdx].lut.data();
+		for (auto s = 0; s < numSamples; ++s)
+		{
+			const auto idx = juce::jlimit(0.f, 1.f, x[s]) * static_cast<float>(Size);
+			const auto iF = static_cast<int>(idx);
+			const auto frac = idx - static_cast<float>(iF);
+			const auto a = lut[iF];
+			dest[s] = a + frac * (lut[iF + 1] - a);
+		}
+	}
+
+	void StageCurve::savePatch(sta::State& state, const String& key) const
+	{
+		state.set(key, "formula", formula, false);
+		String pts;
+		for (const auto& pt : points)
+			pts += String(pt.x) + " " + String(pt.y) + ";";
+		state.set(key, "points", pts, false);
+	}
+
+	void StageCurve::loadPatch(const sta::State& state, const String& key)
+	{
+		const auto formulaVar = state.get(key, "formula");
+		if (formulaVar != nullptr && formulaVar->toString().isNotEmpty())
+		{
+			if (setFormula(formulaVar->toString()))
+				return;
+		}
+
+		const auto pointsVar = state.get(key, "points");
+		if (pointsVar != nullptr)
+		{
+			Points pts;
+			for (const auto& pt : juce::StringArray::fromTokens(pointsVar->toString(), ";", ""))
+			{
+				const auto xy = juce::StringArray::fromTokens(pt, " ", "");
+				if (xy.size() == 2)
+					pts.push_back({ xy[0].getFloatValue(), xy[1].getFloatValue() });
+			}
+			if (setSpline(pts))
+				return;
+		}
+
+		if (isEnabled() || !formula.isEmpty() || !points.empty())
+			clear();
+	}
+
+	void StageCurve::bake(std::vector<float>& values)
+	{
+		const auto numValues = static_cast<int>(values.size());
+		const auto first = values.front();
+		const auto range = values.back() - first;
+
+		// a curve that doesn't go anywhere can't be normalized, it's linear then
+		if (std::abs(range) < 1e-6f || std::isnan(range) || std::isinf(range))
+			for (auto i = 0; i < numValues; ++i)
+				values[i] = static_cast<float>(i) / static_cast<float>(numValues - 1);
+		else
+		{
+			const auto rangeInv = 1.f / range;
+			for (auto& v : values)
+				v = (v - first) * rangeInv;
+		}
+
+		auto& lut = tables[backIdx].lut;
+		static constexpr int HalfCell = Oversampling / 2;
+		lut[0] = 0.f;
+		for (auto i = 1; i < Size; ++i)
+		{
+			// trapezoid over the cell, so that the window is centred on the entry
+			const auto centre = i * Oversampling;
+			auto sum = .5f * (values[centre - HalfCell] + values[centre + HalfCell]);
+			for (auto j = centre - HalfCell + 1; j < centre + HalfCell; ++j)
+				sum += values[j];
+			lut[i] = sum / static_cast<float>(Oversampling);
+		}
+		lut[Size] = lut[Size + 1] = 1.f;
+
+		tables[backIdx].enabled = true;
+		publish();
+	}
+
+	void StageCurve::publish() noexcept
+	{
+		backIdx = middleIdx.exchange(backIdx | NewBit) & IdxMask;
+	}
+}
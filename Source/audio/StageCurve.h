@@ -0,0 +1,70 @@
+#pragma once
+#include "AudioUtils.h"
+
+namespace audio
+{
+	// a user defined shape of an envelope stage, from a formula or a spline.
+	// the curve is baked into a lookup table on the message thread and picked up by the audio thread
+	// at the start of the next block, so that it costs one linear interpolation per sample.
+	// the curve is normalized to go from 0 at x = 0 to 1 at x = 1, so that the stages stay connected.
+	struct StageCurve
+	{
+		static constexpr int Size = 512;
+		// each entry is the mean of the curve over its cell, so that corners and steps don't alias
+		static constexpr int Oversampling = 8;
+
+		using Points = std::vector<juce::Point<float>>;
+
+		StageCurve();
+
+		/* formula of x [0, 1], not realtime safe. returns false if the formula is invalid */
+		bool setFormula(const String&);
+
+		/* points [0, 1], sorted by x. not realtime safe. returns false if there are less than 2 points */
+		bool setSpline(const Points&);
+
+		/* goes back to the built-in skew, not realtime safe */
+		void clear();
+
+		/* called by the audio thread at the start of a block, takes the newest curve */
+		void update() noexcept;
+
+		bool isEnabled() const noexcept;
+
+		/* x [0, 1] */
+		float operator()(float) const noexcept;
+
+		/* dest, x, numSamples
+		dest and x can be the same buffer */
+		void operator()(float*, const float*, int) const noexcept;
+
+		/* state, key */
+		void savePatch(sta::State&, const String&) const;
+
+		/* state, key */
+		void loadPatch(const sta::State&, const String&);
+
+	protected:
+		struct Table
+		{
+			std::array<float, Size + 2> lut;
+			bool enabled;
+		};
+
+		static constexpr int NewBit = 4;
+		static constexpr int IdxMask = 3;
+
+		// triple buffer, the message thread writes back, the audio thread reads front
+		std::array<Table, 3> tables;
+		int backIdx, frontIdx;
+		std::atomic<int> middleIdx;
+		// what the curve was made of, for the patch
+		String formula;
+		Points points;
+
+		/* values of the curve at Size * Oversampling + 1 points in [0, 1] */
+		void bake(std::vector<float>&);
+
+		void publish() noexcept;
+	};
+}
@@ -10,7 +10,8 @@ namespace audio
 		xen(12.f),
 		masterTune(440.f),
 		baseNote(69.f),
-		temperaments()
+		temperaments(),
+		version(0)
 	{
 		for (auto& t : temperaments)
 			t = 0.f;
@@ -18,17 +19,23 @@ namespace audio
 
 	void XenManager::setTemperament(float tmprVal, int noteVal) noexcept
 	{
+		const auto changed = temperaments[noteVal].load() != tmprVal;
 		temperaments[noteVal] = tmprVal;
 		const auto idx2 = noteVal + PPD_MaxXen;
 		if (idx2 >= temperaments.size())
 			temperaments[idx2] = tmprVal;
+		if (changed)
+			++version;
 	}
 
 	void XenManager::operator()(float _xen, float _masterTune, float _baseNote) noexcept
 	{
+		const auto changed = xen != _xen || masterTune != _masterTune || baseNote != _baseNote;
 		xen = _xen;
 		masterTune = _masterTune;
 		baseNote = _baseNote;
+		if (changed)
+			++version;
 	}
 
 	template<typename Float>
@@ -62,6 +69,11 @@ namespace audio
 		return xen;
 	}
 
+	int XenManager::getVersion() const noexcept
+	{
+		return version.load();
+	}
+
 	template float XenManager::noteToFreqHz<float>(float note) const noexcept;
 	template double XenManager::noteToFreqHz<double>(double note) const noexcept;
 
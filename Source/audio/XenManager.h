@@ -27,9 +27,13 @@ namespace audio
 		
 		float getXen() const noexcept;
 
+		/* changes whenever the tuning changed, so that tables of frequencies know when to update */
+		int getVersion() const noexcept;
+
 	protected:
 		float xen, masterTune, baseNote;
 		std::array<std::atomic<float>, PPD_MaxXen + 1> temperaments;
+		std::atomic<int> version;
 	};
 	
 }
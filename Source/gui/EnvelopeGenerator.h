@@ -5,8 +5,7 @@
 namespace gui
 {
 	struct EnvGenComp :
-		public Comp,
-		public Timer
+		public Comp
 	{
 		using MIDI = juce::MidiBuffer;
 		using EnvGen = audio::EnvGenMIDI;
@@ -30,7 +29,7 @@ namespace gui
 			
 			StateComp(Utils& u, String&& _name, State _state, PID pIDShape) :
 				Knob(u),
-				pathNorm(), pathMod(),
+				curveNorm(), curveMod(),
 				state(_state)
 			{
 				makeParameter(*this, pIDShape, std::move(_name), true);
@@ -46,15 +45,15 @@ namespace gui
 					g.setColour(Colours::c(ColourID::Hover));
 					g.fillAll();
 				}
-				if (!pathMod.isEmpty())
+				if (!curveMod.path.isEmpty())
 				{
 					g.setColour(Colours::c(ColourID::Mod));
-					g.strokePath(pathMod, Stroke(thicc));
+					g.strokePath(curveMod.path, Stroke(thicc));
 				}
-				if (!pathNorm.isEmpty())
+				if (!curveNorm.path.isEmpty())
 				{
 					g.setColour(Colours::c(ColourID::Interact));
-					g.strokePath(pathNorm, Stroke(thicc));
+					g.strokePath(curveNorm.path, Stroke(thicc));
 				}
 			}
 			
@@ -70,6 +69,8 @@ namespace gui
 				repaint();
 			}
 
+			/* startY, endY, skewNorm, skewMod
+			only rebuilds and repaints the curves whose shape changed */
 			void update(float startY, float endY, float skewNorm, float skewMod)
 			{
 				if (state != kAtk)
@@ -81,32 +82,14 @@ namespace gui
 				skewMod = std::tanh(Pi * skewMod) * .5f + .5f;
 				
 				const auto thicc = utils.thicc;
-				const auto thicc2 = thicc * 2.f;
 				const auto bnds = getLocalBounds().toFloat();
 				const auto w = bnds.getWidth();
 				const auto h = bnds.getHeight();
-				const auto wInv = 1.f / w;
-				const auto rangeY = endY - startY;
 				
-				pathNorm.clear();
-				pathNorm.startNewSubPath({ 0.f, startY * h });
-				for (auto i = thicc2; i < w; i += thicc2)
-				{
-					const auto x = EnvGen::getSkewed(i * wInv, skewNorm);
-					const auto y = startY + x * rangeY;
-					pathNorm.lineTo({ i, y * h });
-				}
-				pathNorm.lineTo({ w, endY * h });
-
-				pathMod.clear();
-				pathMod.startNewSubPath({ 0.f, startY * h });
-				for (auto i = thicc2; i < w; i += thicc2)
-				{
-					const auto x = EnvGen::getSkewed(i * wInv, skewMod);
-					const auto y = startY + x * rangeY;
-					pathMod.lineTo({ i, y * h });
-				}
-				pathMod.lineTo({ w, endY * h });
+				const auto normChanged = curveNorm.update(startY, endY, skewNorm, w, h, thicc);
+				const auto modChanged = curveMod.update(startY, endY, skewMod, w, h, thicc);
+				if (normChanged || modChanged)
+					repaint();
 			}
 
 			void resized() override
@@ -121,11 +104,54 @@ namespace gui
 				const auto w = bnds.getWidth();
 				
 				const auto pathlen = static_cast<int>(w / thicc2) + 1;
-				pathMod.preallocateSpace(pathlen);
-				pathNorm.preallocateSpace(pathlen);
+				curveMod.path.preallocateSpace(pathlen * 3);
+				curveNorm.path.preallocateSpace(pathlen * 3);
 			}
-			
-			Path pathNorm, pathMod;
+
+			// a path and the values it was built from
+			struct Curve
+			{
+				Curve() :
+					path(),
+					startY(0.f), endY(0.f), skew(0.f), width(0.f), height(0.f), thicc(0.f)
+				{}
+
+				/* startY, endY, skew, width, height, thicc
+				returns true if the path had to be rebuilt */
+				bool update(float _startY, float _endY, float _skew, float w, float h, float _thicc)
+				{
+					if (!path.isEmpty() && startY == _startY && endY == _endY && skew == _skew
+						&& width == w && height == h && thicc == _thicc)
+						return false;
+
+					startY = _startY;
+					endY = _endY;
+					skew = _skew;
+					width = w;
+					height = h;
+					thicc = _thicc;
+
+					const auto thicc2 = thicc * 2.f;
+					const auto wInv = 1.f / w;
+					const auto rangeY = endY - startY;
+
+					path.clear();
+					path.startNewSubPath({ 0.f, startY * h });
+					for (auto i = thicc2; i < w; i += thicc2)
+					{
+						const auto x = EnvGen::getSkewed(i * wInv, skew);
+						const auto y = startY + x * rangeY;
+						path.lineTo({ i, y * h });
+					}
+					path.lineTo({ w, endY * h });
+					return true;
+				}
+
+				Path path;
+				float startY, endY, skew, width, height, thicc;
+			};
+
+			Curve curveNorm, curveMod;
 			State state;
 		};
 		
@@ -133,7 +159,6 @@ namespace gui
 			PID _atkShape, PID _dcyShape, PID _rlsShape,
 			PID _atkBeats, PID _dcyBeats, PID _rlsBeats, PID _tempoSync, PID _dcyRlsLocked) :
 			Comp(u, "Click here to interact with the envelope generator.", CursorType::Default),
-			Timer(),
 			bounds(),
 			pIDs{ _atk, _dcy, _sus, _rls, _atkShape, _dcyShape, _rlsShape, _atkBeats, _dcyBeats, _rlsBeats, _tempoSync, _dcyRlsLocked },
 			pVals(),
@@ -146,7 +171,8 @@ namespace gui
 			},
 			atk(), dcy(), rls(),
 			tempoSyncEnabled(u.getParam(_tempoSync)->getValMod() > .5f),
-			lockDcyRlsEnabled(u.getParam(_dcyRlsLocked)->getValMod() > .5f)
+			lockDcyRlsEnabled(u.getParam(_dcyRlsLocked)->getValMod() > .5f),
+			frame(u.getFrameScheduler(), [this]() { onFrame(); })
 		{
 			for (auto& v : pVals)
 				v = 0.f;
@@ -162,7 +188,8 @@ namespace gui
 				{ 3, 13, 13, 21, 34, 3 }
 			);
 
-			startTimerHz(PPDFPSKnobs);
+			for (auto pID : pIDs)
+				frame.watch(pID);
 		}
 
 		void paint(Graphics& g) override
@@ -186,7 +213,7 @@ namespace gui
 			update();
 		}
 		
-		void timerCallback() override
+		void onFrame()
 		{
 			const auto ts = utils.getParam(pIDs[kTempoSync])->getValMod() > .5f;
 			const auto ldr = utils.getParam(pIDs[kDcyRlsLocked])->getValMod() > .5f;
@@ -198,11 +225,9 @@ namespace gui
 				resized();
 			}
 
+			// the state comps repaint the curves that changed, moved comps repaint themselves
 			if (needsUpdate())
-			{
 				update();
-				repaint();
-			}
 		}
 
 		bool needsUpdate() noexcept
@@ -405,6 +430,7 @@ namespace gui
 		std::array<StateComp, 4> stateComps;
 		std::unique_ptr<Knob> atk, dcy, rls;
 		bool tempoSyncEnabled, lockDcyRlsEnabled;
+		FrameScheduler::Client frame;
 		
 		void switchTimeParameters(bool tempoSync, bool dcyRlsLocked)
 		{
@@ -25,7 +25,8 @@ namespace gui
 				auto x = -1.f;
 				const auto inc = 2.f / static_cast<float>(size);
 				for (auto i = 0; i < size; ++i, x += inc)
-					tables[0][i] = fx(x);
+					tables[0][i] = x;
+				fx(tables[0], tables[0], size);
 			}
 
 			const auto sizeInv = 1.f / static_cast<float>(size);
@@ -0,0 +1,103 @@
+#include "FrameScheduler.h"
+
+namespace gui
+{
+	// CLIENT
+
+	FrameScheduler::Client::Client(FrameScheduler& _scheduler, Callback&& _callback, int fps) :
+		callback(_callback),
+		scheduler(_scheduler),
+		pIDs(),
+		interval(0.),
+		next(0.),
+		polling(false),
+		pending(true)
+	{
+		pIDs.fill(0);
+		setFPS(fps);
+		scheduler.add(this);
+	}
+
+	FrameScheduler::Client::~Client()
+	{
+		scheduler.remove(this);
+	}
+
+	void FrameScheduler::Client::watch(PID pID) noexcept
+	{
+		param::DirtyFlags::set(pIDs, pID);
+		pending = true;
+	}
+
+	void FrameScheduler::Client::setPolling(bool e) noexcept
+	{
+		polling = e;
+	}
+
+	void FrameScheduler::Client::setFPS(int fps) noexcept
+	{
+		interval = 1000. / static_cast<double>(std::max(fps, 1));
+	}
+
+	// SCHEDULER
+
+	FrameScheduler::FrameScheduler(Component& pluginTop, Params& params) :
+		dirtyFlags(params.getDirtyFlags()),
+		clients(),
+		dirty(),
+		dispatching(false),
+		vblank(&pluginTop, [this]() { onVBlank(); })
+	{
+		dirty.fill(0);
+	}
+
+	void FrameScheduler::add(Client* c)
+	{
+		clients.push_back(c);
+	}
+
+	void FrameScheduler::remove(const Client* c)
+	{
+		for (auto i = 0; i < clients.size(); ++i)
+			if (clients[i] == c)
+			{
+				// callbacks can destroy clients, the gaps are closed after the frame
+				if (dispatching)
+					clients[i] = nullptr;
+				else
+					clients.erase(clients.begin() + i);
+				return;
+			}
+	}
+
+	void FrameScheduler::onVBlank()
+	{
+		const auto now = Time::getMillisecondCounterHiRes();
+		dirtyFlags.take(dirty);
+
+		dispatching = true;
+		// clients added by a callback are part of this frame already
+		for (auto i = 0; i < clients.size(); ++i)
+		{
+			auto c = clients[i];
+			if (c == nullptr)
+				continue;
+
+			if (param::DirtyFlags::intersects(c->pIDs, dirty))
+				c->pending = true;
+
+			if (now < c->next || !(c->pending || c->polling))
+				continue;
+
+			c->pending = false;
+			c->next += c->interval;
+			if (c->next < now)
+				c->next = now + c->interval;
+			if (c->callback)
+				c->callback();
+		}
+		dispatching = false;
+
+		clients.erase(std::remove(clients.begin(), clients.end(), nullptr), clients.end());
+	}
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include "Using.h"
+
+namespace gui
+{
+	// drives the periodic updates of all components of an editor from one vblank callback,
+	// instead of a timer per component. a client runs on the frames where one of its params changed,
+	// which the params mark in their dirty flags, or on every frame if it polls something else, like a meter.
+	// either way not more often than its fps.
+	class FrameScheduler
+	{
+		using Bits = param::DirtyFlags::Bits;
+	public:
+		using Callback = std::function<void()>;
+
+		struct Client
+		{
+			/* scheduler, callback, fps */
+			Client(FrameScheduler&, Callback&& = nullptr, int = PPDFPSKnobs);
+
+			~Client();
+
+			/* runs the callback on the frames where this param changed */
+			void watch(PID) noexcept;
+
+			/* runs the callback on every frame, if it polls something that isn't a param */
+			void setPolling(bool) noexcept;
+
+			void setFPS(int) noexcept;
+
+			Callback callback;
+		protected:
+			FrameScheduler& scheduler;
+			Bits pIDs;
+			double interval, next;
+			bool polling, pending;
+
+			friend class FrameScheduler;
+		};
+
+		/* pluginTop, params */
+		FrameScheduler(Component&, Params&);
+
+	protected:
+		param::DirtyFlags& dirtyFlags;
+		std::vector<Client*> clients;
+		Bits dirty;
+		bool dispatching;
+		juce::VBlankAttachment vblank;
+
+		void add(Client*);
+
+		void remove(const Client*);
+
+		void onVBlank();
+	};
+}
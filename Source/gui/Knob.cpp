@@ -14,6 +14,11 @@ namespace gui
         onDoubleClick([](Knob&) {}),
         onDrag([](Knob&, PointF&, bool) {}),
         onUp([](Knob&, const Mouse&) {}),
+        frame(u.getFrameScheduler(), [this]()
+        {
+            if (onTimer(*this))
+                repaint();
+        }),
         onTimer([](Knob&) { return false; }),
         onPaint([](Knob&, Graphics&) {}),
         getInfo([](int) { return ""; }),
@@ -53,12 +58,6 @@ namespace gui
         );
     }
 
-    void Knob::timerCallback()
-    {
-        if (onTimer(*this))
-            repaint();
-    }
-
     void Knob::paint(juce::Graphics& g)
     {
         onPaint(*this, g);
@@ -927,6 +926,9 @@ namespace gui
             return shallRepaint;
         };
 
+        knob.frame.watch(mainPID);
+        knob.frame.setPolling(hasMeter);
+
         knob.comps.reserve(looks::NumComps);
 
         modulatable = modulatable && isKnobLooksTypeModulatable(looksType);
@@ -1072,8 +1074,6 @@ namespace gui
                 }
             }
         }
-
-        knob.startTimerHz(PPDFPSKnobs);
     }
 
     void makeParameter(Knob& knob, PID pIDHorizontal, PID pIDVertical)
@@ -1308,9 +1308,9 @@ namespace gui
             return shallRepaint;
         };
 
-        knob.comps.reserve(looks::NumComps);
+        knob.frame.watch(mainPID);
 
-        knob.startTimerHz(PPDFPSKnobs);
+        knob.comps.reserve(looks::NumComps);
     }
 	
     // CONTEXT MENU
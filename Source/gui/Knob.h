@@ -6,8 +6,7 @@
 namespace gui
 {
     struct Knob :
-        public Comp,
-        public Timer
+        public Comp
     {
         using Func = std::function<void(Knob&)>;
         using OnDrag = std::function<void(Knob&, PointF&, bool)>;
@@ -26,8 +25,6 @@ namespace gui
 
         void init(std::vector<int>&&, std::vector<int>&&);
 
-        void timerCallback() override;
-
         void paint(juce::Graphics&) override;
 
         void resized() override;
@@ -51,6 +48,8 @@ namespace gui
         Func onEnter, onExit, onDown, onWheel, onResize, onDoubleClick;
         OnDrag onDrag;
         OnUp onUp;
+        // runs onTimer on the editor's frames where the knob's params changed
+        FrameScheduler::Client frame;
         OnTimer onTimer;
         OnPaint onPaint;
         GetInfo getInfo;
@@ -26,12 +26,13 @@ namespace gui
 				PID::EnvGenReleaseBeats,
                 PID::EnvGenTempoSync, PID::EnvGenLockDcyRls
             ),
-			mode(u), lowerLimit(u), upperLimit(u), midiChannel(u), midiCC(u),
+			mode(u), lowerLimit(u), upperLimit(u), midiChannel(u), midiCC(u), ccRate(u), ccResolution(u),
             atk(u), sus(u), atkBeats(u),
             dcy(), rls(), dcyBeats(), rlsBeats(),
             lockDcyRls(u),
             oscope(u, "The oscilloscope visualizes the ADSR shape.", u.audioProcessor.oscope),
             legato(u),
+            voices(u),
             inverse(u),
             tempoSync(u),
             velo(u),
@@ -55,6 +56,12 @@ namespace gui
 			makeParameter(midiCC, PID::ControllerCC, "CC");
             addChildComponent(midiCC);
 
+			makeParameter(ccRate, PID::ControllerRate, "Rate");
+			addChildComponent(ccRate);
+
+			makeParameter(ccResolution, PID::ControllerResolution, "Res");
+			addChildComponent(ccResolution);
+
             makeParameter(atk, PID::EnvGenAttack, "Attack", true);
             addChildComponent(atk);
 
@@ -75,6 +82,9 @@ namespace gui
 			makeParameter(legato, PID::EnvGenLegato, "Legato");
             addAndMakeVisible(legato);
 
+			makeParameter(voices, PID::EnvGenVoices, "Voices");
+			addAndMakeVisible(voices);
+
             makeParameter(inverse, PID::EnvGenInverse, ButtonSymbol::InvertADSR);
             addAndMakeVisible(inverse);
 
@@ -145,8 +155,17 @@ namespace gui
             layout.place(mode, 1, 0, 1, 1);
 			layout.place(lowerLimit, 2.f, 0, 2.f / 3.f, 1);
 			layout.place(upperLimit, 2.f + 2.f / 3.f, 0, 2.f / 3.f, 1);
-            layout.place(midiChannel, 3.f + 1.f / 3.f, 0, 2.f / 3.f, 1);
-			layout.place(midiCC, 4.f, 0, 2.f / 3.f, 1);
+            {
+                const auto ccW = 5.f / 12.f;
+                auto ccX = 3.f + 1.f / 3.f;
+                layout.place(midiChannel, ccX, 0, ccW, 1);
+                ccX += ccW;
+			    layout.place(midiCC, ccX, 0, ccW, 1);
+                ccX += ccW;
+                layout.place(ccRate, ccX, 0, ccW, 1);
+                ccX += ccW;
+                layout.place(ccResolution, ccX, 0, ccW, 1);
+            }
 
             layout.place(envGen, 1, 1, 4, 1);
 
@@ -170,7 +189,8 @@ namespace gui
             );
             oscope.setBounds(oscopeBounds.toNearestInt());
 
-            layout.place(legato, 1, 5, 1, 1, false);
+            layout.place(legato, 1.f, 5, .5f, 1, false);
+			layout.place(voices, 1.5f, 5, .5f, 1, false);
             layout.place(inverse, 2, 5, 1, 1, true);
 			layout.place(tempoSync, 3, 5, 1, 1, true);
             layout.place(velo, 4, 5, 1, 1, false);
@@ -192,6 +212,8 @@ namespace gui
             bool isCCMode = modeVal == Mode::MIDICC;
 			midiChannel.setVisible(isCCMode);
 			midiCC.setVisible(isCCMode);
+			ccRate.setVisible(isCCMode);
+			ccResolution.setVisible(isCCMode);
 
 			auto _dcyRlsLinkEnabled = utils.getParam(PID::EnvGenLockDcyRls)->getValMod() > .5f;
             if (dcyRlsLinkEnabled != _dcyRlsLinkEnabled)
@@ -219,12 +241,12 @@ namespace gui
 
     protected:
         EnvGenComp envGen;
-        Knob mode, lowerLimit, upperLimit, midiChannel, midiCC;
+        Knob mode, lowerLimit, upperLimit, midiChannel, midiCC, ccRate, ccResolution;
 		Knob atk, sus, atkBeats;
         FlexKnob dcy, rls, dcyBeats, rlsBeats;
         Button lockDcyRls;
         Oscilloscope oscope;
-        Knob legato;
+        Knob legato, voices;
         Button inverse, tempoSync;
         Knob velo;
         bool dcyRlsLinkEnabled, atkExceedsLatency;
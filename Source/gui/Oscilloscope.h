@@ -4,21 +4,30 @@
 
 namespace gui
 {
+	// the background and the curve are cached in images. every frame only the pixel columns
+	// of the samples that were written since the last frame are rendered and repainted.
+	// the images have the resolution of the display, so that they are sharp on hidpi screens.
 	struct Oscilloscope :
-		public Comp,
-		public Timer
+		public Comp
 	{
 		using Oscope = audio::Oscilloscope;
+		using Pyramid = audio::OscopePyramid;
 		static constexpr int FPS = 24;
 
 		Oscilloscope(Utils& u, String&& _tooltip, const Oscope& _oscope) :
-			Comp(u, _tooltip, CursorType::Default),
-			Timer(),
+			Comp(u, _tooltip, makeNotify(*this), CursorType::Default),
 			oscope(_oscope),
+			frame(u.getFrameScheduler(), [this]() { onFrame(); }, FPS),
+			background(),
 			curve(),
+			bandMin(),
+			bandMax(),
+			samplesPerPx(0.f),
+			scale(1.f),
+			renderAll(true),
 			bipolar(true)
 		{
-			startTimerHz(FPS);
+			frame.setPolling(true);
 		}
 
 		void resized() override
@@ -26,64 +35,188 @@ namespace gui
 			const auto thicc = utils.thicc;
 			bounds = getLocalBounds().toFloat().reduced(thicc);
 
-			curve = Path();
-			curve.preallocateSpace(static_cast<int>(bounds.getWidth()) + 1);
+			const auto numPx = static_cast<int>(bounds.getWidth()) + 1;
+			bandMin.resize(numPx + 2);
+			bandMax.resize(numPx + 2);
+			renderAll = true;
 		}
 
 		void paint(Graphics& g) override
 		{
-			const auto thicc = utils.thicc;
-			Stroke stroke(thicc, Stroke::JointStyle::beveled, Stroke::EndCapStyle::rounded);
-			
-			g.setColour(Colours::c(ColourID::Darken));
-			g.fillRoundedRectangle(bounds, thicc);
-			
-			const auto data = oscope.data();
-			const auto size = oscope.windowLength();
-			const auto sizeF = static_cast<float>(size);
-			const auto beatLength = oscope.getBeatLength();
-			const auto w = bounds.getWidth();
-			const auto h = bounds.getHeight();
-			const auto xScale = w / std::min(beatLength, sizeF);
-			const auto bipolarVal = bipolar ? 1.f : 0.f;
-			const auto yScale = h - bipolarVal * (h * .5f - h);
-			const auto xScaleInv = 1.f / xScale;
-			const auto xOff = bounds.getX();
-			const auto yOff = bounds.getY() + yScale;
-			
-			curve.clear();
-			auto y = yOff - data[0] * yScale;
-			curve.startNewSubPath(xOff, y);
-			for (auto i = 1.f; i <= w; ++i)
+			if (renderAll)
 			{
-				const auto x = xOff + i;
-				const auto idx = static_cast<int>(i * xScaleInv);
-				y = yOff - data[idx] * yScale;
-				curve.lineTo(x, y);
+				renderAll = false;
+				renderBackground();
+				const auto& pyramid = oscope.acquire();
+				samplesPerPx = getSamplesPerPx(pyramid);
+				render(pyramid, 0, getNumPx());
 			}
 
-			g.setColour(Colours::c(ColourID::Txt));
-			g.strokePath(curve, stroke);
-		}
-
-		void timerCallback() override
-		{
-			repaint();
+			const auto toLogical = Affine::scale(1.f / scale);
+			g.drawImageTransformed(background, toLogical, false);
+			g.drawImageTransformed(curve, toLogical, false);
 		}
 
 	protected:
 		const Oscope& oscope;
+		FrameScheduler::Client frame;
 		BoundsF bounds;
-		Path curve;
+		Image background, curve;
+		std::vector<float> bandMin, bandMax;
+		float samplesPerPx, scale;
+		bool renderAll;
 	public:
 		bool bipolar;
-	};
-}
+	protected:
+		Notify makeNotify(Oscilloscope& comp)
+		{
+			return [&oscope = comp](EvtType type, const void*)
+			{
+				if (type == EvtType::ColourSchemeChanged)
+					oscope.renderAll = true;
+			};
+		}
+
+		void onFrame()
+		{
+			if (!oscope.isUpdated() || renderAll)
+				return;
+
+			const auto& pyramid = oscope.acquire();
+			if (pyramid.getNumLevels() < 1 || bounds.getWidth() < 1.f)
+				return;
+
+			// a new bar length or window moves every column, another display changes every pixel
+			const auto spp = getSamplesPerPx(pyramid);
+			if (spp != samplesPerPx || getPixelScale() != scale)
+			{
+				renderAll = true;
+				return repaint();
+			}
+
+			// the neighbours of the changed columns connect to them
+			const auto numPx = getNumPx();
+			for (const auto& span : pyramid.changed)
+			{
+				const auto px0 = juce::jlimit(0, numPx, static_cast<int>(static_cast<float>(span.lo) / spp) - 1);
+				const auto px1 = juce::jlimit(0, numPx, static_cast<int>(std::ceil(static_cast<float>(span.hi) / spp)) + 2);
+				if (px0 >= px1)
+					continue;
+
+				render(pyramid, px0, px1);
+				const auto x = static_cast<int>(bounds.getX()) + px0;
+				repaint(x, 0, px1 - px0 + 1, getHeight());
+			}
+		}
+
+		// physical pixels per logical pixel
+		float getPixelScale() const
+		{
+			auto s = Component::getApproximateScaleFactorForComponent(this);
+			if (const auto display = juce::Desktop::getInstance().getDisplays().getDisplayForRect(getScreenBounds()))
+				s *= static_cast<float>(display->scale);
+			return std::max(s, 1.f);
+		}
+
+		/* logical x, the physical pixel where it starts */
+		int toPhysical(int x) const noexcept
+		{
+			return static_cast<int>(std::round(static_cast<float>(x) * scale));
+		}
 
-/*
+		int getNumPx() const noexcept
+		{
+			return static_cast<int>(bounds.getWidth()) + 1;
+		}
 
-todo:
+		float getSamplesPerPx(const Pyramid& pyramid) const noexcept
+		{
+			const auto sizeF = static_cast<float>(pyramid.windowLength);
+			const auto lenF = std::min(pyramid.beatLength, sizeF);
+			return lenF / bounds.getWidth();
+		}
 
-performance: only repaint part if the interface that was changed
+		void renderBackground()
+		{
+			const auto thicc = utils.thicc;
+			scale = getPixelScale();
+			background = Image(Image::ARGB, std::max(toPhysical(getWidth()), 1), std::max(toPhysical(getHeight()), 1), true);
+			curve = Image(Image::ARGB, background.getWidth(), background.getHeight(), true);
 
-*/
\ No newline at end of file
+			Graphics g{ background };
+			g.addTransform(Affine::scale(scale));
+			g.setColour(Colours::c(ColourID::Darken));
+			g.fillRoundedRectangle(bounds, thicc);
+		}
+
+		/* pyramid, px0, px1
+		every pixel column gets the min/max of its samples,
+		from the coarsest level that still has at least one bin per column.
+		the columns are snapped to physical pixels, so that neighbouring renders don't leave seams. */
+		void render(const Pyramid& pyramid, int px0, int px1)
+		{
+			const auto xOff = static_cast<int>(bounds.getX());
+			const auto x0 = toPhysical(xOff + px0);
+			curve.clear({ x0, 0, toPhysical(xOff + px1) - x0, curve.getHeight() });
+			if (pyramid.getNumLevels() < 1 || bounds.getWidth() < 1.f)
+				return;
+
+			const auto thicc = utils.thicc;
+			const auto h = bounds.getHeight();
+			const auto bipolarVal = bipolar ? 1.f : 0.f;
+			const auto yScale = h - bipolarVal * (h * .5f - h);
+			const auto yOff = bounds.getY() + yScale;
+
+			auto level = 0;
+			while (level + 1 < pyramid.getNumLevels() && Pyramid::getBinSize(level + 1) <= samplesPerPx)
+				++level;
+			const auto numBins = pyramid.getNumBins(level);
+			const auto binsPerPx = samplesPerPx / static_cast<float>(Pyramid::getBinSize(level));
+			const auto mins = pyramid.getMin(level);
+			const auto maxs = pyramid.getMax(level);
+
+			// bands of px0 - 1 to px1, at index + 1
+			const auto numPx = getNumPx();
+			const auto b0 = std::max(px0 - 1, 0);
+			const auto b1 = std::min(px1 + 1, numPx);
+			for (auto px = b0; px < b1; ++px)
+			{
+				const auto bin0 = std::min(static_cast<int>(static_cast<float>(px) * binsPerPx), numBins - 1);
+				const auto bin1 = juce::jlimit(bin0 + 1, numBins, static_cast<int>(std::ceil(static_cast<float>(px + 1) * binsPerPx)));
+				auto mn = mins[bin0];
+				auto mx = maxs[bin0];
+				for (auto b = bin0 + 1; b < bin1; ++b)
+				{
+					mn = std::min(mn, mins[b]);
+					mx = std::max(mx, maxs[b]);
+				}
+				bandMin[px + 1] = mn;
+				bandMax[px + 1] = mx;
+			}
+			if (b0 == 0)
+			{
+				bandMin[0] = bandMin[1];
+				bandMax[0] = bandMax[1];
+			}
+			if (b1 == numPx)
+			{
+				bandMin[numPx + 1] = bandMin[numPx];
+				bandMax[numPx + 1] = bandMax[numPx];
+			}
+
+			Graphics g{ curve };
+			g.setColour(Colours::c(ColourID::Txt));
+			const auto thiccHalf = thicc * .5f;
+			for (auto px = px0; px < px1; ++px)
+			{
+				const auto i = px + 1;
+				const auto top = std::max({ bandMax[i], bandMin[i - 1], bandMin[i + 1] });
+				const auto btm = std::min({ bandMin[i], bandMax[i - 1], bandMax[i + 1] });
+				const auto y0 = (yOff - top * yScale - thiccHalf) * scale;
+				const auto y1 = (yOff - btm * yScale + thiccHalf) * scale;
+				const auto x = toPhysical(xOff + px);
+				g.fillRect(static_cast<float>(x), y0, static_cast<float>(toPhysical(xOff + px + 1) - x), y1 - y0);
+			}
+		}
+	};
+}
@@ -1,13 +1,13 @@
 #include "Shader.h"
 
 gui::Shader::Shader(Utils& u, Component& _comp) :
-    Timer(),
     comp(_comp),
     utils(u),
     notify(u.getEventSystem()),
-    bypassed(false)
+    bypassed(false),
+    frame(u.getFrameScheduler(), [this]() { onFrame(); }, 12)
 {
-    startTimerHz(12);
+    frame.watch(PID::Power);
 }
 
 void gui::Shader::applyEffect(Image& img, Graphics& g, float, float)
@@ -39,7 +39,7 @@ void gui::Shader::paintBypassed(Image& img, Graphics& g)
     g.drawFittedText("bypassed", img.getBounds(), Just::centredRight, 1);
 }
 
-void gui::Shader::timerCallback()
+void gui::Shader::onFrame()
 {
     bool shallRepaint = false;
 
@@ -5,8 +5,7 @@
 namespace gui
 {
     struct Shader :
-        juce::ImageEffectFilter,
-        Timer
+        juce::ImageEffectFilter
     {
         Shader(Utils&, Component&);
 
@@ -16,9 +15,10 @@ namespace gui
         Utils& utils;
         Evt notify;
         bool bypassed;
+        FrameScheduler::Client frame;
 
         void paintBypassed(Image&, Graphics&);
 
-        void timerCallback() override;
+        void onFrame();
     };
 }
\ No newline at end of file
@@ -8,54 +8,131 @@ namespace gui
 		mainColCID(ColourID::Hover),
 		xen(u.audioProcessor.xenManager),
 		beam(_beam),
-		img(Image::RGB, Size, 1, true)
+		frame(u.getFrameScheduler(), [this]() { onFrame(); }, 60),
+		img(Image::ARGB, Size, NumRows, true),
+		binIdx(Size, 0),
+		binFrac(Size, 0.f),
+		mags(Size, 0.f),
+		keyToColour(),
+		colours(),
+		colBase(), colMain(),
+		sampleRate(0.),
+		xenVersion(-1),
+		keyMin(0),
+		row(0)
 	{
 		setInterceptsMouseClicks(false, false);
-		startTimerHz(60);
 		setOpaque(true);
+		frame.setPolling(true);
+
+		// the magnitude range in dB, linear over the colours
+		keyMin = toKey(audio::decibelToGain(LowestDb));
+		const auto keyMax = toKey(audio::decibelToGain(HighestDb));
+		keyToColour.resize(keyMax - keyMin + 1);
+		const auto rangeDbInv = 1.f / (HighestDb - LowestDb);
+		for (auto k = keyMin; k <= keyMax; ++k)
+		{
+			// the centre of the key's range of floats
+			const auto bits = static_cast<juce::uint32>((k << KeyShift) | (1 << (KeyShift - 1)));
+			float gain;
+			std::memcpy(&gain, &bits, sizeof(float));
+			const auto norm = juce::jlimit(0.f, 1.f, (audio::gainToDecibel(gain) - LowestDb) * rangeDbInv);
+			keyToColour[k - keyMin] = static_cast<juce::uint8>(std::round(norm * static_cast<float>(NumColours - 1)));
+		}
+
+		updateColours();
 	}
 
 	template<size_t Order>
 	void SpectroBeamComp<Order>::paint(Graphics& g)
 	{
+		// the rows from row on are the newest, the ones before it the oldest
 		g.setImageResamplingQuality(Graphics::lowResamplingQuality);
-		g.drawImage(img, getLocalBounds().toFloat());
+		const auto w = getWidth();
+		const auto h = getHeight();
+		const auto split = static_cast<int>(std::round(static_cast<float>(h * (NumRows - row)) / static_cast<float>(NumRows)));
+		g.drawImage(img, 0, 0, w, split, 0, row, Size, NumRows - row);
+		if (row != 0)
+			g.drawImage(img, 0, split, w, h - split, 0, 0, Size, row);
 	}
 
 	template<size_t Order>
-	void SpectroBeamComp<Order>::timerCallback()
+	void SpectroBeamComp<Order>::onFrame()
 	{
-		auto ready = beam.ready.load();
-		if (!ready)
+		if (!beam.isUpdated())
 			return;
 
-		const auto Fs = static_cast<float>(utils.audioProcessor.getSampleRate());
-		const auto fsInv = 1.f / Fs;
-		const auto colBase = Colours::c(ColourID::Bg);
-		const auto col = Colours::c(mainColCID);
-		const auto buf = beam.buffer.data();
+		const auto Fs = utils.audioProcessor.getSampleRate();
+		if (Fs != sampleRate || xen.getVersion() != xenVersion)
+			updateBinMap(Fs);
+		if (Colours::c(ColourID::Bg) != colBase || Colours::c(mainColCID) != colMain)
+			updateColours();
 
-		const auto lowestDb = -12.f;
-		const auto highestDb = 6.f;
-		const auto rangeDb = highestDb - lowestDb;
-		const auto rangeDbInv = 1.f / rangeDb;
+		// gathers the interpolated magnitude of every column
+		const auto spectrum = beam.acquire();
+		for (auto x = 0; x < Size; ++x)
+		{
+			const auto i = binIdx[x];
+			const auto a = spectrum[i];
+			const auto b = spectrum[i + 1];
+			mags[x] = a + binFrac[x] * (b - a);
+		}
+
+		row = (row + NumRows - 1) % NumRows;
+		const auto numKeys = static_cast<int>(keyToColour.size());
+		{
+			Image::BitmapData bitmap(img, 0, row, Size, 1, Image::BitmapData::writeOnly);
+			auto line = bitmap.getLinePointer(0);
+			const auto stride = bitmap.pixelStride;
+			for (auto x = 0; x < Size; ++x)
+			{
+				const auto k = juce::jlimit(0, numKeys - 1, toKey(mags[x]) - keyMin);
+				*reinterpret_cast<juce::PixelARGB*>(line + x * stride) = colours[keyToColour[k]];
+			}
+		}
+
+		repaint();
+	}
 
+	template<size_t Order>
+	void SpectroBeamComp<Order>::updateBinMap(double Fs)
+	{
+		sampleRate = Fs;
+		xenVersion = xen.getVersion();
+
+		const auto fsInv = Fs > 0. ? 1.f / static_cast<float>(Fs) : 0.f;
+		const auto maxIdx = static_cast<float>(SpecBeam::NumBins - 2);
 		for (auto x = 0; x < Size; ++x)
 		{
 			const auto norm = static_cast<float>(x) * SizeInv;
 			const auto pitch = norm * 128.f;
 			const auto freqHz = xen.noteToFreqHzWithWrap(pitch + xen.getXen());
-			const auto binIdx = freqHz * fsInv * SizeF;
+			const auto idx = juce::jlimit(0.f, maxIdx, freqHz * fsInv * SizeF);
+			const auto iFloor = std::floor(idx);
+			binIdx[x] = static_cast<int>(iFloor);
+			binFrac[x] = idx - iFloor;
+		}
+	}
 
-			const auto bin = interpolate::lerp(buf, binIdx);
-			const auto magDb = audio::gainToDecibel(bin);
-			const auto magMapped = juce::jlimit(0.f, 1.f, (magDb - lowestDb) * rangeDbInv);
-			const auto nCol = colBase.interpolatedWith(col, magMapped);
-			img.setPixelAt(x, 0, nCol);
+	template<size_t Order>
+	void SpectroBeamComp<Order>::updateColours()
+	{
+		colBase = Colours::c(ColourID::Bg);
+		colMain = Colours::c(mainColCID);
+		for (auto i = 0; i < NumColours; ++i)
+		{
+			const auto norm = static_cast<float>(i) / static_cast<float>(NumColours - 1);
+			colours[i] = colBase.interpolatedWith(colMain, norm).withAlpha(1.f).getPixelARGB();
 		}
+		img.clear(img.getBounds(), colBase.withAlpha(1.f));
+	}
 
-		beam.ready.store(false);
-		repaint();
+	template<size_t Order>
+	int SpectroBeamComp<Order>::toKey(float gain) noexcept
+	{
+		juce::uint32 bits;
+		std::memcpy(&bits, &gain, sizeof(float));
+		return static_cast<int>(bits >> KeyShift);
 	}
 
 	template struct SpectroBeamComp<8>;
@@ -66,4 +143,4 @@ namespace gui
 	template struct SpectroBeamComp<13>;
 	template struct SpectroBeamComp<14>;
 	template struct SpectroBeamComp<15>;
-}
\ No newline at end of file
+}
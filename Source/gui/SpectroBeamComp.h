@@ -8,27 +8,51 @@
 
 namespace gui
 {
+	// a waterfall of the spectra, the newest row on top.
+	// the pitch of every column maps to a precomputed bin and weight, that only change with the tuning
+	// or the sample rate. magnitudes map to colours through a table indexed by their float bits,
+	// so a row costs a lookup per pixel, written straight into the image.
 	template<size_t Order>
 	struct SpectroBeamComp :
-		public Comp,
-		public Timer
+		public Comp
 	{
 		using SpecBeam = audio::SpectroBeam<Order>;
 		static constexpr int Size = SpecBeam::Size;
 		static constexpr float SizeF = static_cast<float>(Size);
 		static constexpr float SizeInv = 1.f / SizeF;
 		static constexpr float SizeFHalf = SizeF * .5f;
+		static constexpr int NumRows = 64;
+		static constexpr int NumColours = 256;
+		static constexpr float LowestDb = -60.f;
+		static constexpr float HighestDb = 0.f;
+		// the exponent and the 8 most significant mantissa bits of a float
+		static constexpr int KeyShift = 15;
 
 		SpectroBeamComp(Utils&, SpecBeam&);
 
 		void paint(Graphics&) override;
 
-		void timerCallback() override;
-		
 		ColourID mainColCID;
 	protected:
 		const audio::XenManager& xen;
 		SpecBeam& beam;
+		FrameScheduler::Client frame;
 		Image img;
+		std::vector<int> binIdx;
+		std::vector<float> binFrac, mags;
+		std::vector<juce::uint8> keyToColour;
+		std::array<juce::PixelARGB, NumColours> colours;
+		Colour colBase, colMain;
+		double sampleRate;
+		int xenVersion, keyMin, row;
+
+		void onFrame();
+
+		/* sampleRate */
+		void updateBinMap(double);
+
+		void updateColours();
+
+		static int toKey(float) noexcept;
 	};
-}
\ No newline at end of file
+}
@@ -9,6 +9,7 @@ namespace gui
 		params(audioProcessor.params),
 		eventSystem(),
 		evt(eventSystem),
+		frameScheduler(_pluginTop, audioProcessor.params),
 		thicc(1.f)
 	{
 		Colours::c.init(audioProcessor.props.getUserSettings());
@@ -108,6 +109,11 @@ namespace gui
 		return eventSystem;
 	}
 
+	FrameScheduler& Utils::getFrameScheduler() noexcept
+	{
+		return frameScheduler;
+	}
+
 	const std::atomic<float>& Utils::getMeter(int i) const noexcept
 	{
 		return audioProcessor.meters(i);
@@ -2,6 +2,7 @@
 #include "Using.h"
 #include "Shared.h"
 #include "Events.h"
+#include "FrameScheduler.h"
 #include "../audio/MIDILearn.h"
 
 namespace gui
@@ -58,6 +59,8 @@ namespace gui
 		float fontHeight() const noexcept;
 
 		EventSystem& getEventSystem();
+
+		FrameScheduler& getFrameScheduler() noexcept;
 	
 		const std::atomic<float>& getMeter(int i) const noexcept;
 
@@ -85,6 +88,7 @@ namespace gui
 		Params& params;
 		EventSystem eventSystem;
 		Evt evt;
+		FrameScheduler frameScheduler;
 	};
 
 	void appendRandomString(String&, Random&, int/*length*/,
@@ -40,6 +40,8 @@ namespace param
 #endif
 #if PPDHasHQ
 		case PID::HQ: return "HQ";
+		case PID::HQFactor: return "HQ Factor";
+		case PID::HQMinPhase: return "HQ Min Phase";
 #endif
 #if PPDHasGainOut
 		case PID::Gain: return "Gain Out";
@@ -94,6 +96,10 @@ namespace param
 		case PID::ControllerChannel: return "Controller Channel";
 		case PID::ControllerCC: return "CC";
 
+		case PID::EnvGenVoices: return "EnvGen Voices";
+		case PID::ControllerRate: return "CC Rate";
+		case PID::ControllerResolution: return "CC Resolution";
+
 		default: return "Invalid Parameter Name";
 		}
 	}
@@ -139,7 +145,9 @@ namespace param
 		case PID::MuteDry: return "Mute the dry signal.";
 #endif
 #if PPDHasHQ
-		case PID::HQ: return "Turn on HQ to apply 2x Oversampling to the signal.";
+		case PID::HQ: return "Turn on HQ to apply oversampling to the signal.";
+		case PID::HQFactor: return "Define how many times the signal is oversampled in HQ mode.";
+		case PID::HQMinPhase: return "Use minimum phase filters in HQ mode, for less latency at the cost of phase shifts.";
 #endif
 #if PPDHasGainOut
 		case PID::Gain: return "Apply output gain to the wet signal.";
@@ -193,6 +201,10 @@ namespace param
 		case PID::ControllerChannel: return "Define the MIDI Channel of th controller output.";
 		case PID::ControllerCC: return "Define the MIDI CC of the controller output.";
 
+		case PID::EnvGenVoices: return "Define the number of voices. With 1 voice the envelope generator is monophonic, with more each note gets its own envelope. In MIDI CC mode every voice sends on its own MIDI channel, so at most 16 voices are used.";
+		case PID::ControllerRate: return "Define how many controller messages per second are sent at most. Values are only sent when they change.";
+		case PID::ControllerResolution: return "Define the resolution of the controller output: 7 bit, 14 bit (CC 0-31 and their LSB partners) or NRPN.";
+
 		default: return "Invalid Tooltip.";
 		}
 	}
@@ -226,12 +238,85 @@ namespace param
 		case Unit::Legato: return "";
 		case Unit::Custom: return "";
 		case Unit::FilterType: return "";
+		case Unit::Oversampling: return "x";
 		default: return "";
 		}
 	}
 
 	// PARAM:
 
+	AutomationQueue::AutomationQueue() :
+		events(),
+		writeIdx(0),
+		readIdx(0)
+	{}
+
+	bool AutomationQueue::push(const AutomationEvent& evt) noexcept
+	{
+		const auto w = writeIdx.load(std::memory_order_relaxed);
+		const auto next = (w + 1) % Size;
+		if (next == readIdx.load(std::memory_order_acquire))
+			return false;
+		events[w] = evt;
+		writeIdx.store(next, std::memory_order_release);
+		return true;
+	}
+
+	bool AutomationQueue::pop(AutomationEvent& evt) noexcept
+	{
+		const auto r = readIdx.load(std::memory_order_relaxed);
+		if (r == writeIdx.load(std::memory_order_acquire))
+			return false;
+		evt = events[r];
+		readIdx.store((r + 1) % Size, std::memory_order_release);
+		return true;
+	}
+
+	bool AutomationQueue::isEmpty() const noexcept
+	{
+		return readIdx.load(std::memory_order_acquire) == writeIdx.load(std::memory_order_acquire);
+	}
+
+	DirtyFlags::DirtyFlags() :
+		words()
+	{
+		setAll();
+	}
+
+	void DirtyFlags::set(PID pID) noexcept
+	{
+		const auto i = static_cast<int>(pID);
+		words[i >> 6].fetch_or(juce::uint64(1) << (i & 63), std::memory_order_release);
+	}
+
+	void DirtyFlags::setAll() noexcept
+	{
+		for (auto& w : words)
+			w.store(~juce::uint64(0), std::memory_order_release);
+	}
+
+	void DirtyFlags::take(Bits& bits) noexcept
+	{
+		for (auto i = 0; i < NumWords; ++i)
+			bits[i] = words[i].load(std::memory_order_relaxed) == 0 ? 0 : words[i].exchange(0, std::memory_order_acq_rel);
+	}
+
+	void DirtyFlags::set(Bits& bits, PID pID) noexcept
+	{
+		const auto i = static_cast<int>(pID);
+		bits[i >> 6] |= juce::uint64(1) << (i & 63);
+	}
+
+	bool DirtyFlags::intersects(const Bits& a, const Bits& b) noexcept
+	{
+		for (auto i = 0; i < NumWords; ++i)
+			if ((a[i] & b[i]) != 0)
+				return true;
+		return false;
+	}
+
+	// PARAM
+
 	Param::Param(const PID pID, const Range& _range, const float _valDenormDefault,
 		const ValToStrFunc& _valToStr, const StrToValFunc& _strToVal,
 		State& _state, const Unit _unit) :
@@ -242,6 +327,7 @@ namespace param
 
 		state(_state),
 		valDenormDefault(_valDenormDefault),
+		valDenormDefaultStored(_valDenormDefault),
 
 		valNorm(range.convertTo0to1(_valDenormDefault)),
 		maxModDepth(0.f),
@@ -255,7 +341,14 @@ namespace param
 		locked(false),
 		inGesture(false),
 
-		modDepthLocked(false)
+		modDepthLocked(false),
+
+		automation(),
+		automationPending(),
+		numAutomationPending(0),
+		automationNorm(valNorm.load()),
+		macroVal(0.f),
+		dirtyFlags(nullptr)
 	{
 	}
 
@@ -270,10 +363,19 @@ namespace param
 		const auto mb = getModBias();
 		state.set(idStr, "modbias", mb, true);
 
+		saveDefault(appProps);
+	}
+
+	void Param::saveDefault(juce::ApplicationProperties& appProps) const
+	{
+		// the user settings are shared by all instances, only write actual changes
+		if (valDenormDefault == valDenormDefaultStored)
+			return;
 		auto user = appProps.getUserSettings();
 		if (user->isValidFile())
 		{
-			user->setValue(idStr + "valDefault", valDenormDefault);
+			user->setValue(getIDString(id) + "valDefault", valDenormDefault);
+			valDenormDefaultStored = valDenormDefault;
 		}
 	}
 
@@ -310,10 +412,22 @@ namespace param
 			{
 				const auto vdd = user->getDoubleValue(idStr + "valDefault", static_cast<double>(valDenormDefault));
 				setDefaultValue(range.convertTo0to1(range.snapToLegalValue(static_cast<float>(vdd))));
+				valDenormDefaultStored = valDenormDefault;
 			}
 		}
 	}
 
+	void Param::loadPatch(float valDenorm, float mmd, float mb, float valDenormDef)
+	{
+		if (isLocked())
+			return;
+
+		setValueNotifyingHost(range.convertTo0to1(range.snapToLegalValue(valDenorm)));
+		setMaxModDepth(mmd);
+		setModBias(mb);
+		valDenormDefault = range.snapToLegalValue(valDenormDef);
+	}
+
 	//called by host, normalized, thread-safe
 	float Param::getValue() const
 	{
@@ -332,7 +446,10 @@ namespace param
 			return;
 
 		if (!modDepthLocked)
-			return valNorm.store(normalized);
+		{
+			valNorm.store(normalized);
+			return markDirty();
+		}
 
 		const auto p0 = valNorm.load();
 		const auto p1 = normalized;
@@ -344,6 +461,101 @@ namespace param
 		setMaxModDepth(d1);
 	}
 
+	void Param::setValue(float normalized, int sampleOffset) noexcept
+	{
+		if (isLocked())
+			return;
+
+		automation.push({ normalized, sampleOffset });
+		setValue(normalized);
+	}
+
+	bool Param::getAutomation(float* dest, int numSamples) noexcept
+	{
+		if (numSamples <= 0)
+			return false;
+
+		auto& pending = automationPending;
+		auto& numPending = numAutomationPending;
+
+		AutomationEvent evt;
+		while (automation.pop(evt))
+		{
+			// dropped if full, the value itself is set already
+			if (numPending == AutomationQueue::Size)
+				continue;
+			auto i = numPending++;
+			for (; i > 0 && pending[i - 1].sampleOffset > evt.sampleOffset; --i)
+				pending[i] = pending[i - 1];
+			pending[i] = evt;
+		}
+
+		if (numPending == 0)
+		{
+			// untimed changes, like the host's automation of most plugin formats, stay with the smoother
+			automationNorm = getValue();
+			return false;
+		}
+
+		// s0 is the last rendered sample, so ramps continue seamlessly from the previous block
+		auto s = 0;
+		auto s0 = -1;
+		auto x0 = automationNorm;
+		auto e = 0;
+		for (; e < numPending && pending[e].sampleOffset < numSamples; ++e)
+		{
+			const auto s1 = std::max(pending[e].sampleOffset, 0);
+			const auto x1 = pending[e].valNorm;
+			if (s1 < s)
+				// more than one event on this sample, the last one wins
+				dest[s - 1] = x1;
+			else
+			{
+				const auto len = static_cast<float>(s1 - s0);
+				for (; s < s1; ++s)
+					dest[s] = x0 + (x1 - x0) * static_cast<float>(s - s0) / len;
+				dest[s] = x1;
+				++s;
+			}
+			s0 = s - 1;
+			x0 = x1;
+		}
+
+		if (e < numPending)
+		{
+			// ramps towards the next event, which is reached in a later block
+			const auto s1 = pending[e].sampleOffset;
+			const auto x1 = pending[e].valNorm;
+			const auto len = static_cast<float>(s1 - s0);
+			for (; s < numSamples; ++s)
+				dest[s] = x0 + (x1 - x0) * static_cast<float>(s - s0) / len;
+		}
+		else
+			for (; s < numSamples; ++s)
+				dest[s] = x0;
+		automationNorm = dest[numSamples - 1];
+
+		numPending -= e;
+		for (auto i = 0; i < numPending; ++i)
+		{
+			pending[i] = pending[i + e];
+			pending[i].sampleOffset -= numSamples;
+		}
+
+		for (s = 0; s < numSamples; ++s)
+			dest[s] = range.convertFrom0to1(calcValModOf(dest[s], macroVal));
+
+		return true;
+	}
+
+	void Param::resetAutomation() noexcept
+	{
+		AutomationEvent evt;
+		while (automation.pop(evt)) {}
+		numAutomationPending = 0;
+		automationNorm = getValue();
+	}
+
 	// called by editor
 	bool Param::isInGesture() const noexcept
 	{
@@ -382,12 +594,16 @@ namespace param
 			return;
 
 		maxModDepth.store(juce::jlimit(-1.f, 1.f, v));
+		markDirty();
 	}
 
 	float Param::calcValModOf(float macro) const noexcept
 	{
-		const auto norm = getValue();
+		return calcValModOf(getValue(), macro);
+	}
 
+	float Param::calcValModOf(float norm, float macro) const noexcept
+	{
 		const auto mmd = maxModDepth.load();
 		const auto pol = mmd > 0.f ? 1.f : -1.f;
 		const auto md = mmd * pol;
@@ -414,6 +630,7 @@ namespace param
 
 		b = juce::jlimit(BiasEps, 1.f - BiasEps, b);
 		modBias.store(b);
+		markDirty();
 	}
 
 	float Param::getModBias() const noexcept
@@ -432,9 +649,16 @@ namespace param
 	}
 
 	// called by processor to update modulation value(s)
-	void Param::modulate(float macro) noexcept
+	float Param::modulate(float macro) noexcept
 	{
-		valMod.store(calcValModOf(macro));
+		macroVal = macro;
+		const auto vm = calcValModOf(macro);
+		if (valMod.load(std::memory_order_relaxed) != vm)
+		{
+			valMod.store(vm);
+			markDirty();
+		}
+		return vm;
 	}
 
 	float Param::getDefaultValue() const
@@ -442,6 +666,11 @@ namespace param
 		return range.convertTo0to1(valDenormDefault);
 	}
 
+	float Param::getDefaultValueDenorm() const noexcept
+	{
+		return valDenormDefault;
+	}
+
 	String Param::getName(int) const
 	{
 		return toString(id);
@@ -497,6 +726,7 @@ namespace param
 	void Param::setLocked(bool e) noexcept
 	{
 		locked.store(e);
+		markDirty();
 	}
 
 	void Param::switchLock() noexcept
@@ -504,6 +734,17 @@ namespace param
 		setLocked(!isLocked());
 	}
 
+	void Param::setDirtyFlags(DirtyFlags* flags) noexcept
+	{
+		dirtyFlags = flags;
+	}
+
+	void Param::markDirty() noexcept
+	{
+		if (dirtyFlags != nullptr)
+			dirtyFlags->set(id);
+	}
+
 	String Param::getIDString(PID pID)
 	{
 		return "params/" + toID(toString(pID));
@@ -899,6 +1140,16 @@ namespace param::strToVal
 				return p(text, 0.f);
 		};
 	}
+
+	StrToValFunc oversampling()
+	{
+		return[p = parse()](const String& txt)
+		{
+			const auto text = txt.trimCharactersAtEnd(toString(Unit::Oversampling));
+			const auto factor = p(text, 2.f);
+			return std::round(std::log2(std::max(factor, 1.f)));
+		};
+	}
 }
 
 namespace param::valToStr
@@ -1154,6 +1405,14 @@ namespace param::valToStr
 			}
 		};
 	}
+
+	ValToStrFunc oversampling()
+	{
+		return [](float v)
+		{
+			return String(1 << static_cast<int>(std::round(v))) + toString(Unit::Oversampling);
+		};
+	}
 }
 
 namespace param
@@ -1252,6 +1511,10 @@ namespace param
 			valToStrFunc = valToStr::filterType();
 			strToValFunc = strToVal::filterType();
 			break;
+		case Unit::Oversampling:
+			valToStrFunc = valToStr::oversampling();
+			strToValFunc = strToVal::oversampling();
+			break;
 		default:
 			valToStrFunc = [](float v) { return String(v); };
 			strToValFunc = [p = param::strToVal::parse()](const String& s)
@@ -1297,6 +1560,7 @@ namespace param
 #endif
 	) :
 		params(),
+		dirtyFlags(),
 		state(_state),
 		modDepthLocked(false)
 	{
@@ -1392,10 +1656,40 @@ namespace param
 		params.push_back(makeParam(PID::UpperLimit, state, 0.f, makeRange::withCentre(-60.f, 0.f, -6.f), Unit::Decibel));
 		params.push_back(makeParam(PID::ControllerChannel, state, 1.f, makeRange::stepped(1.f, 16.f), Unit::NumUnits));
 		params.push_back(makeParam(PID::ControllerCC, state, 0.f, makeRange::stepped(0.f, 127.f), Unit::NumUnits));
+
+		params.push_back(makeParam(PID::EnvGenVoices, state, 1.f, makeRange::stepped(1.f, 64.f), Unit::Voices));
+
+		auto valToStrResolution = [](float v)
+		{
+			return String(v < .5f ? "7 Bit" : v < 1.5f ? "14 Bit" : "NRPN");
+		};
+		auto strToValResolution = [p = strToVal::parse()](const String& s)
+		{
+			if (s == "7 Bit")
+				return 0.f;
+			if (s == "14 Bit")
+				return 1.f;
+			if (s == "NRPN")
+				return 2.f;
+			auto val = p(s, 0.f);
+			return val;
+		};
+
+		params.push_back(makeParam(PID::ControllerRate, state, 500.f, makeRange::withCentre(1.f, 2000.f, 200.f), Unit::Hz));
+		params.push_back(makeParam(PID::ControllerResolution, state, 0.f, makeRange::stepped(0.f, 2.f), valToStrResolution, strToValResolution));
 		// LOW LEVEL PARAMS END
 
+		// APPENDED PARAMS, in the order of the enum:
+#if PPDHasHQ
+		params.push_back(makeParam(PID::HQFactor, state, 1.f, makeRange::stepped(1.f, 3.f), Unit::Oversampling));
+		params.push_back(makeParam(PID::HQMinPhase, state, 0.f, makeRange::toggle(), Unit::Power));
+#endif
+
 		for (auto param : params)
+		{
+			param->setDirtyFlags(&dirtyFlags);
 			audioProcessor.addParameter(param);
+		}
 	}
 
 	void Params::loadPatch(juce::ApplicationProperties& appProps)
@@ -1418,6 +1712,76 @@ namespace param
 		state.set(idStr, "moddepthlocked", isModDepthLocked() ? 1 : 0);
 	}
 
+	void Params::saveDefaults(juce::ApplicationProperties& appProps) const
+	{
+		for (auto param : params)
+			param->saveDefault(appProps);
+	}
+
+	// the params of the table are identified by the hash of their id, so that
+	// reordered or removed params of other versions still find their values.
+	static const std::array<int, NumParams>& getParamHashes()
+	{
+		static const std::array<int, NumParams> hashes = []()
+		{
+			std::array<int, NumParams> h;
+			for (auto i = 0; i < NumParams; ++i)
+				h[i] = toID(toString(static_cast<PID>(i))).hashCode();
+			return h;
+		}();
+		return hashes;
+	}
+
+	void Params::savePatch(juce::OutputStream& stream) const
+	{
+		const auto& hashes = getParamHashes();
+		stream.writeShort(static_cast<short>(params.size()));
+		stream.writeBool(isModDepthLocked());
+		for (auto i = 0; i < params.size(); ++i)
+		{
+			const auto param = params[i];
+			stream.writeInt(hashes[i]);
+			stream.writeFloat(param->range.convertFrom0to1(param->getValue()));
+			stream.writeFloat(param->getMaxModDepth());
+			stream.writeFloat(param->getModBias());
+			stream.writeFloat(param->getDefaultValueDenorm());
+		}
+	}
+
+	int Params::getEntrySize(int version) noexcept
+	{
+		// version 1 had no defaults
+		return version < 2 ? 4 * 4 : 5 * 4;
+	}
+
+	bool Params::loadPatch(juce::InputStream& stream, int version)
+	{
+		const auto& hashes = getParamHashes();
+		const auto numEntries = static_cast<int>(stream.readShort());
+		if (numEntries < 0 || stream.getNumBytesRemaining() < 1 + numEntries * getEntrySize(version))
+			return false;
+
+		setModDepthLocked(stream.readBool());
+		for (auto e = 0; e < numEntries; ++e)
+		{
+			const auto hash = stream.readInt();
+			const auto val = stream.readFloat();
+			const auto mmd = stream.readFloat();
+			const auto mb = stream.readFloat();
+			const auto valDef = version < 2 ? 0.f : stream.readFloat();
+
+			// same version: same index
+			auto i = e < NumParams && hashes[e] == hash ? e : -1;
+			for (auto j = 0; i == -1 && j < NumParams; ++j)
+				if (hashes[j] == hash)
+					i = j;
+			if (i != -1)
+				params[i]->loadPatch(val, mmd, mb,
+					version < 2 ? params[i]->getDefaultValueDenorm() : valDef);
+		}
+		return true;
+	}
+
 	String Params::getIDString()
 	{
 		return "params";
@@ -1445,6 +1809,8 @@ namespace param
 
 	const Params::Parameters& Params::data() const noexcept { return params; }
 
+	DirtyFlags& Params::getDirtyFlags() noexcept { return dirtyFlags; }
+
 	bool Params::isModDepthLocked() const noexcept { return modDepthLocked.load(); }
 
 	void Params::setModDepthLocked(bool e) noexcept
@@ -1459,17 +1825,63 @@ namespace param
 		setModDepthLocked(!isModDepthLocked());
 	}
 
+	// PARAM SNAPSHOT
+
+	ParamSnapshot::ParamSnapshot() :
+		valMod(),
+		valModDenorm(),
+		dirty()
+	{
+		// nan, so that the first block marks everything as dirty
+		valMod.fill(std::numeric_limits<float>::quiet_NaN());
+		valModDenorm.fill(0.f);
+		dirty.set();
+	}
+
+	float ParamSnapshot::getValMod(PID pID) const noexcept
+	{
+		return valMod[static_cast<int>(pID)];
+	}
+
+	float ParamSnapshot::getValModDenorm(PID pID) const noexcept
+	{
+		return valModDenorm[static_cast<int>(pID)];
+	}
+
+	bool ParamSnapshot::isDirty(PID pID) const noexcept
+	{
+		return dirty[static_cast<int>(pID)];
+	}
+
 	// MACRO PROCESSOR
 
 	MacroProcessor::MacroProcessor(Params& _params) :
-		params(_params)
+		params(_params),
+		snapshot()
 	{
 	}
 
-	void MacroProcessor::operator()() noexcept
+	const ParamSnapshot& MacroProcessor::operator()() noexcept
 	{
-		const auto modDepth = params[PID::Macro]->getValue();
-		for (auto i = 1; i < NumParams; ++i)
-			params[i]->modulate(modDepth);
+		auto& prms = params.data();
+		const auto macro = prms[0];
+		const auto modDepth = macro->getValue();
+
+		// the macro itself isn't modulated
+		auto vm = modDepth;
+		for (auto i = 0; i < NumParams; ++i)
+		{
+			if (i != 0)
+				vm = prms[i]->modulate(modDepth);
+
+			const auto changed = snapshot.valMod[i] != vm;
+			snapshot.dirty[i] = changed;
+			if (changed)
+			{
+				snapshot.valMod[i] = vm;
+				snapshot.valModDenorm[i] = prms[i]->range.convertFrom0to1(vm);
+			}
+		}
+		return snapshot;
 	}
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <functional>
+#include <bitset>
 
 #include "juce_core/juce_core.h"
 #include "juce_audio_processors/juce_audio_processors.h"
@@ -86,12 +87,23 @@ namespace param
 		ControllerChannel,
 		ControllerCC,
 
+		EnvGenVoices,
+
+		ControllerRate,
+		ControllerResolution,
+
+		// params of later versions are appended, so that the hosts' indices of the others stay the same
+#if PPDHasHQ
+		HQFactor,
+		HQMinPhase,
+#endif
+
 		NumParams
 	};
 
 	static constexpr int NumParams = static_cast<int>(PID::NumParams);
 	static constexpr int MinLowLevelIdx = static_cast<int>(PID::Power) + 1;
-	static constexpr int NumLowLevelParams = NumParams - MinLowLevelIdx;
+	static constexpr int NumLowLevelParams = static_cast<int>(PID::ControllerResolution) + 1 - MinLowLevelIdx;
 
 	/* pID, offset */
 	PID ll(PID, int) noexcept;
@@ -135,6 +147,7 @@ namespace param
 		Legato,
 		Custom,
 		FilterType,
+		Oversampling,
 		NumUnits
 	};
 
@@ -151,6 +164,59 @@ namespace param
 	using State = sta::State;
 	using Xen = audio::XenManager&;
 
+	struct AutomationEvent
+	{
+		float valNorm;
+		int sampleOffset;
+	};
+
+	// lock-free, one producer (the host's automation) and one consumer (the audio thread).
+	struct AutomationQueue
+	{
+		static constexpr int Size = 256;
+
+		AutomationQueue();
+
+		/* returns false if the queue is full */
+		bool push(const AutomationEvent&) noexcept;
+
+		/* returns false if the queue is empty */
+		bool pop(AutomationEvent&) noexcept;
+
+		bool isEmpty() const noexcept;
+
+	protected:
+		std::array<AutomationEvent, Size> events;
+		std::atomic<int> writeIdx, readIdx;
+	};
+
+	// one bit per param, set whenever its value, modulation or lock changes.
+	// any thread sets bits, the editor takes them once per frame, so that it
+	// only looks at the params that changed since.
+	struct DirtyFlags
+	{
+		static constexpr int NumWords = (NumParams + 63) / 64;
+		using Bits = std::array<juce::uint64, NumWords>;
+
+		DirtyFlags();
+
+		void set(PID) noexcept;
+
+		void setAll() noexcept;
+
+		/* bits, writes the bits that were set since the last call and clears them */
+		void take(Bits&) noexcept;
+
+		/* bits, pID */
+		static void set(Bits&, PID) noexcept;
+
+		/* a, b */
+		static bool intersects(const Bits&, const Bits&) noexcept;
+
+	protected:
+		std::array<std::atomic<juce::uint64>, NumWords> words;
+	};
+
 	class Param :
 		public ParameterBase
 	{
@@ -164,6 +230,12 @@ namespace param
 
 		void loadPatch(juce::ApplicationProperties&);
 
+		/* valDenorm, maxModDepth, modBias, valDenormDefault */
+		void loadPatch(float, float, float, float);
+
+		/* writes the default to the user settings, if it changed */
+		void saveDefault(juce::ApplicationProperties&) const;
+
 		//called by host, normalized, thread-safe
 		float getValue() const override;
 
@@ -171,6 +243,22 @@ namespace param
 
 		// called by host, normalized, avoid locks, not used by editor
 		void setValue(float/*normalized*/) override;
+
+		// called by host with the sample offset of the value in the next block.
+		// makes the value reach the parameter's automation ramp on that exact sample.
+		// offsets beyond the next block are reached in the block they fall into.
+		void setValue(float/*normalized*/, int/*sampleOffset*/) noexcept;
+
+		/* dest, numSamples
+		called by processor once per block. if the block has automation events, dest is
+		filled with the modulated denormalized values, ramping linearly from the last rendered
+		value to each event in turn, across blocks.
+		returns false if there are no events, then dest is untouched and the value is smoothed. */
+		bool getAutomation(float*, int) noexcept;
+
+		/* drops the events and starts the next ramp from the current value.
+		called by processor while it is suspended */
+		void resetAutomation() noexcept;
 		
 		// called by editor
 		bool isInGesture() const noexcept;
@@ -188,6 +276,9 @@ namespace param
 		/*macro*/
 		float calcValModOf(float) const noexcept;
 
+		/*norm, macro*/
+		float calcValModOf(float, float) const noexcept;
+
 		float getValMod() const noexcept;
 
 		float getValModDenorm() const noexcept;
@@ -198,11 +289,13 @@ namespace param
 
 		void setDefaultValue(float/*norm*/) noexcept;
 
-		// called by processor to update modulation value(s)
-		void modulate(float/*macro*/) noexcept;
+		// called by processor to update modulation value(s), returns the modulated value
+		float modulate(float/*macro*/) noexcept;
 
 		float getDefaultValue() const override;
 
+		float getDefaultValueDenorm() const noexcept;
+
 		String getName(int) const override;
 
 		// units of param (hz, % etc.)
@@ -229,6 +322,9 @@ namespace param
 
 		float biased(float /*start*/, float /*end*/, float /*bias [0,1]*/, float /*x*/) const noexcept;
 
+		/* the flags this param marks when it changes */
+		void setDirtyFlags(DirtyFlags*) noexcept;
+
 		static String getIDString(PID);
 
 		const PID id;
@@ -236,6 +332,8 @@ namespace param
 	protected:
 		State& state;
 		float valDenormDefault;
+		// the default as last read from or written to the user settings
+		mutable float valDenormDefaultStored;
 		std::atomic<float> valNorm, maxModDepth, valMod, modBias;
 		ValToStrFunc valToStr;
 		StrToValFunc strToVal;
@@ -244,6 +342,16 @@ namespace param
 		std::atomic<bool> locked, inGesture;
 
 		bool modDepthLocked;
+
+		AutomationQueue automation;
+		// the events taken from the queue that aren't reached yet, in order, offsets relative to the next block
+		std::array<AutomationEvent, AutomationQueue::Size> automationPending;
+		int numAutomationPending;
+		// the last rendered value of the ramp
+		float automationNorm, macroVal;
+		DirtyFlags* dirtyFlags;
+
+		void markDirty() noexcept;
 	};
 
 	struct Params
@@ -261,6 +369,18 @@ namespace param
 
 		void savePatch(juce::ApplicationProperties&) const;
 
+		/* stream, writes the binary param table */
+		void savePatch(juce::OutputStream&) const;
+
+		/* stream, version, reads a binary param table. returns false if it's malformed */
+		bool loadPatch(juce::InputStream&, int);
+
+		/* version, the size of an entry of the binary param table */
+		static int getEntrySize(int) noexcept;
+
+		/* writes the changed defaults to the user settings */
+		void saveDefaults(juce::ApplicationProperties&) const;
+
 		static String getIDString();
 
 		int getParamIdx(const String& /*nameOrID*/) const;
@@ -278,8 +398,11 @@ namespace param
 
 		Parameters& data() noexcept;
 		const Parameters& data() const noexcept;
+
+		DirtyFlags& getDirtyFlags() noexcept;
 	protected:
 		Parameters params;
+		DirtyFlags dirtyFlags;
 
 		State& state;
 		std::atomic<float> modDepthLocked;
@@ -311,6 +434,7 @@ namespace param
 		StrToValFunc beats();
 		StrToValFunc legato();
 		StrToValFunc filterType();
+		StrToValFunc oversampling();
 	}
 
 	namespace valToStr
@@ -341,15 +465,38 @@ namespace param
 		ValToStrFunc beats();
 		ValToStrFunc legato();
 		ValToStrFunc filterType();
+		ValToStrFunc oversampling();
 	}
 
+	// the modulated values of all parameters of one block, as structure of arrays.
+	// written and read by the audio thread only. the editor keeps using the params.
+	struct ParamSnapshot
+	{
+		ParamSnapshot();
+
+		/* pID */
+		float getValMod(PID) const noexcept;
+
+		/* pID */
+		float getValModDenorm(PID) const noexcept;
+
+		/* pID, true if the modulated value changed since the last block */
+		bool isDirty(PID) const noexcept;
+
+		std::array<float, NumParams> valMod, valModDenorm;
+		std::bitset<NumParams> dirty;
+	};
+
 	struct MacroProcessor
 	{
 		MacroProcessor(Params&);
 
-		void operator()() noexcept;
+		/* modulates all parameters and returns their snapshot of this block.
+		the range conversion is only done for parameters that changed. */
+		const ParamSnapshot& operator()() noexcept;
 
 		Params& params;
+		ParamSnapshot snapshot;
 	};
 	
 }
\ No newline at end of file
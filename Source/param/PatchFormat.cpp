@@ -0,0 +1,111 @@
+#include "PatchFormat.h"
+
+namespace param
+{
+	namespace patchFormat
+	{
+		using ValueTree = juce::ValueTree;
+
+		static std::array<juce::uint32, 256> makeCRCTable() noexcept
+		{
+			std::array<juce::uint32, 256> table;
+			for (juce::uint32 i = 0; i < 256; ++i)
+			{
+				auto c = i;
+				for (auto k = 0; k < 8; ++k)
+					c = (c & 1) != 0 ? 0xedb88320 ^ (c >> 1) : c >> 1;
+				table[i] = c;
+			}
+			return table;
+		}
+
+		juce::uint32 crc32(const void* data, size_t size) noexcept
+		{
+			static const auto table = makeCRCTable();
+
+			auto bytes = static_cast<const juce::uint8*>(data);
+			juce::uint32 c = 0xffffffff;
+			for (size_t i = 0; i < size; ++i)
+				c = table[(c ^ bytes[i]) & 0xff] ^ (c >> 8);
+			return c ^ 0xffffffff;
+		}
+
+		void write(const Params& params, const sta::State& state, juce::MemoryBlock& destData)
+		{
+			juce::MemoryOutputStream payload;
+			params.savePatch(payload);
+
+			// the root's properties and all children except the params, which are in the table
+			const auto tree = state.getState();
+			const auto paramsTree = tree.getChildWithName(Params::getIDString());
+
+			ValueTree root(tree.getType());
+			root.copyPropertiesFrom(tree, nullptr);
+			root.writeToStream(payload);
+			payload.writeCompressedInt(tree.getNumChildren() - (paramsTree.isValid() ? 1 : 0));
+			for (auto child : tree)
+				if (child != paramsTree)
+					child.writeToStream(payload);
+
+			const auto payloadSize = static_cast<int>(payload.getDataSize());
+
+			juce::MemoryOutputStream stream(destData, false);
+			stream.preallocate(HeaderSize + payloadSize);
+			stream.writeInt(Magic);
+			stream.writeInt(Version);
+			stream.writeInt(payloadSize);
+			stream.writeInt(static_cast<int>(crc32(payload.getData(), payload.getDataSize())));
+			stream.write(payload.getData(), payload.getDataSize());
+		}
+
+		ReadResult read(Params& params, sta::State& state, const void* data, int sizeInBytes)
+		{
+			if (data == nullptr || sizeInBytes < HeaderSize)
+				return ReadResult::NotBinary;
+
+			juce::MemoryInputStream stream(data, static_cast<size_t>(sizeInBytes), false);
+			if (stream.readInt() != Magic)
+				return ReadResult::NotBinary;
+			const auto version = stream.readInt();
+			const auto payloadSize = stream.readInt();
+			const auto crc = static_cast<juce::uint32>(stream.readInt());
+			if (version < 1 || version > Version || payloadSize < 0 || payloadSize > sizeInBytes - HeaderSize)
+				return ReadResult::Corrupt;
+
+			const auto payloadData = static_cast<const char*>(data) + HeaderSize;
+			if (crc32(payloadData, static_cast<size_t>(payloadSize)) != crc)
+				return ReadResult::Corrupt;
+
+			juce::MemoryInputStream payload(payloadData, static_cast<size_t>(payloadSize), false);
+
+			// parse everything before applying anything, so that corrupt data changes nothing
+			const auto paramsPos = payload.getPosition();
+			{
+				const auto numEntries = static_cast<int>(payload.readShort());
+				const auto tableSize = 1 + numEntries * Params::getEntrySize(version);
+				if (numEntries < 0 || payload.getNumBytesRemaining() < tableSize)
+					return ReadResult::Corrupt;
+				payload.skipNextBytes(tableSize);
+			}
+
+			auto root = ValueTree::readFromStream(payload);
+			if (!root.isValid())
+				return ReadResult::Corrupt;
+			const auto numChildren = payload.readCompressedInt();
+			for (auto i = 0; i < numChildren; ++i)
+			{
+				auto child = ValueTree::readFromStream(payload);
+				if (!child.isValid())
+					return ReadResult::Corrupt;
+				root.appendChild(child, nullptr);
+			}
+
+			// the params check the table before they apply it, so the state follows only if they succeeded
+			payload.setPosition(paramsPos);
+			if (!params.loadPatch(payload, version))
+				return ReadResult::Corrupt;
+			state.loadPatch(root);
+			return ReadResult::Ok;
+		}
+	}
+}
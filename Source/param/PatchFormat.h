@@ -0,0 +1,33 @@
+#pragma once
+#include "Param.h"
+
+namespace param
+{
+	// the binary format of the plugin's state, which the host saves with its sessions.
+	//
+	// header (little endian): magic, version, payload size, crc32 of the payload
+	// payload: the param table, then the rest of the state as binary value tree.
+	//
+	// data that doesn't start with the magic is the xml of older versions.
+	namespace patchFormat
+	{
+		static constexpr int Magic = 0x52534441; // "ADSR"
+		// 2: the param table has the defaults
+		static constexpr int Version = 2;
+		static constexpr int HeaderSize = 4 * 4;
+
+		/* data, size */
+		juce::uint32 crc32(const void*, size_t) noexcept;
+
+		/* params, state, destData
+		writes the params' table instead of their entries in the state. */
+		void write(const Params&, const sta::State&, juce::MemoryBlock&);
+
+		enum class ReadResult { NotBinary, Corrupt, Ok };
+
+		/* params, state, data, sizeInBytes
+		NotBinary: the data doesn't start with the magic, so it may be the xml of older versions.
+		Corrupt: the data has the magic but is malformed. nothing is applied. */
+		ReadResult read(Params&, sta::State&, const void*, int);
+	}
+}
@@ -0,0 +1,727 @@
+/*
+	ADSRBench: microbenchmarks for the envelope generator and the midi delay of the lookahead.
+
+	usage:
+	ADSRBench [--filter <substring>] [--repetitions <n>] [--verify]
+
+	Every benchmark renders a fixed budget of samples in blocks of the given size,
+	repeated n times (default 5). The fastest repetition is reported.
+	cycles/sample are time stamp counter cycles and only available on x86.
+
+	names: EnvGen/<stage or midi density>/<free or sync>/<blockSize>
+		   EnvGen/Poly<numVoices>/<free or sync>/<blockSize>
+		   Skew/<kernel>/<blockSize>
+		   Curve/<blockSize>
+		   MIDIDelay/<events per block>/<blockSize>
+		   EnvFol/<blockSize>
+		   Level/<Peak, RMS or TruePeak>/<blockSize>
+
+	Before benchmarking, every skew kernel available on this cpu is checked against
+	the scalar reference. The run fails if any output sample is not bit-identical.
+	The envelope follower is checked against the per-sample follower it replaced,
+	bit-identical with constant times, also when the input equals the envelope.
+	The plugin state is checked to keep the params' values and defaults.
+	--verify only runs these checks, this is what ctest runs.
+*/
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <iomanip>
+#include <random>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "audio/EnvelopeGenerator.h"
+#include "audio/MIDIDelay.h"
+#include "audio/EnvelopeFollower.h"
+#include "arch/Smooth.h"
+#include "Processor.h"
+
+namespace bench
+{
+	using String = juce::String;
+	using Clock = std::chrono::high_resolution_clock;
+	using EnvGenMIDI = audio::EnvGenMIDI;
+	using MIDIBuffer = audio::MIDIBuffer;
+	using MIDIMessage = audio::MIDIMessage;
+	using PlayHeadPos = audio::PlayHeadPos;
+
+	static constexpr float Fs = 44100.f;
+	static constexpr int SampleBudget = 1 << 20;
+	static constexpr int MaxBlockSize = 4096;
+
+	inline juce::uint64 cycles() noexcept
+	{
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+		return static_cast<juce::uint64>(__rdtsc());
+#else
+		return 0;
+#endif
+	}
+
+	enum class Stage
+	{
+		Attack,
+		Decay,
+		Sustain,
+		Release,
+		Dense,
+		Poly,
+		NumStages
+	};
+
+	inline String toString(Stage s)
+	{
+		switch (s)
+		{
+		case Stage::Attack: return "Attack";
+		case Stage::Decay: return "Decay";
+		case Stage::Sustain: return "Sustain";
+		case Stage::Release: return "Release";
+		case Stage::Dense: return "Dense";
+		case Stage::Poly: return "Poly";
+		default: return "";
+		}
+	}
+
+	// the arguments of EnvGenMIDI::operator() except midi and numSamples
+	struct Config
+	{
+		/* stage, tempoSync, numVoices */
+		Config(Stage stage, bool _tempoSync, int _numVoices = 1) :
+			atk(32000.f), dcy(32000.f), sus(.5f), rls(32000.f),
+			atkShape(.5f), dcyShape(-.5f), rlsShape(-.5f),
+			legato(0), numVoices(_numVoices), inverse(false), velo(0.f), tempoSync(_tempoSync),
+			atkBeats(16.f), dcyBeats(16.f), rlsBeats(16.f),
+			playHead()
+		{
+			// a stage is reached by skipping the ones before it
+			if (stage == Stage::Decay || stage == Stage::Sustain || stage == Stage::Release)
+			{
+				atk = 0.f;
+				atkBeats = 0.f;
+			}
+			if (stage == Stage::Sustain || stage == Stage::Release)
+			{
+				dcy = 0.f;
+				dcyBeats = 0.f;
+			}
+			if (stage == Stage::Dense || stage == Stage::Poly)
+			{
+				atk = dcy = rls = 5.f;
+				atkBeats = dcyBeats = rlsBeats = 1.f / 64.f;
+			}
+
+			playHead.bpm = 120.;
+			playHead.ppqPosition = 0.;
+			playHead.isPlaying = true;
+			playHead.timeInSamples = 0;
+		}
+
+		void operator()(EnvGenMIDI& envGen, MIDIBuffer& midi, int numSamples) const noexcept
+		{
+			envGen
+			(
+				midi, numSamples,
+				atk, dcy, sus, rls,
+				atkShape, dcyShape, rlsShape,
+				legato, numVoices, inverse, velo, tempoSync,
+				atkBeats, dcyBeats, rlsBeats,
+				playHead
+			);
+		}
+
+		float atk, dcy, sus, rls, atkShape, dcyShape, rlsShape;
+		int legato, numVoices;
+		bool inverse;
+		float velo;
+		bool tempoSync;
+		float atkBeats, dcyBeats, rlsBeats;
+		PlayHeadPos playHead;
+	};
+
+	struct Result
+	{
+		double nsPerSample, cyclesPerSample;
+	};
+
+	namespace skew = audio::skew;
+
+	// random ramps and biases plus the edge cases of the curve (x and bias on 0 and 1, xy == 0)
+	inline void makeSkewInput(std::vector<float>& x, std::vector<float>& bias, int size)
+	{
+		std::mt19937 rng(420);
+		std::uniform_real_distribution<float> dist(0.f, 1.f);
+		x.resize(size);
+		bias.resize(size);
+		for (auto i = 0; i < size; ++i)
+		{
+			x[i] = dist(rng);
+			bias[i] = dist(rng);
+		}
+
+		const float edges[] = { 0.f, 1.f, .5f, 1.f / 3.f, std::numeric_limits<float>::min(), 1.f - std::numeric_limits<float>::epsilon() };
+		auto i = 0;
+		for (auto xE : edges)
+			for (auto bE : edges)
+				if (i < size)
+				{
+					x[i] = xE;
+					bias[i] = bE;
+					++i;
+				}
+	}
+
+	/* returns false if any kernel differs from the scalar reference */
+	inline bool verifySkewKernels()
+	{
+		static constexpr int Size = (1 << 16) + 7;
+		std::vector<float> x, bias, ref(Size), out(Size);
+		makeSkewInput(x, bias, Size);
+
+		for (auto i = 0; i < Size; ++i)
+			ref[i] = skew::getSkewed(x[i], bias[i]);
+
+		auto valid = true;
+		for (auto k = 0; k < static_cast<int>(skew::Kernel::NumKernels); ++k)
+		{
+			const auto kernel = static_cast<skew::Kernel>(k);
+			const auto func = skew::getKernel(kernel);
+			if (func == nullptr)
+				continue;
+
+			// odd offsets and lengths, so that the remainder loops are covered too
+			for (auto offset = 0; offset < 3; ++offset)
+			{
+				std::fill(out.begin(), out.end(), -1.f);
+				func(out.data() + offset, x.data() + offset, bias.data() + offset, Size - offset);
+
+				auto numMismatches = 0;
+				for (auto i = offset; i < Size; ++i)
+					if (std::memcmp(&out[i], &ref[i], sizeof(float)) != 0)
+						++numMismatches;
+
+				if (numMismatches != 0)
+				{
+					std::cout << "Skew/" << skew::toString(kernel) << ": " << numMismatches << " samples differ from the scalar reference\n";
+					valid = false;
+				}
+			}
+		}
+
+		std::cout << "skew kernels verified, runtime pick: " << skew::toString(skew::getBestKernel()) << "\n\n";
+		return valid;
+	}
+
+	/* returns false if a param's value or changed default doesn't survive a round trip through the plugin state */
+	inline bool verifyState()
+	{
+		using PID = param::PID;
+		static constexpr PID pID = PID::EnvGenAttack;
+
+		juce::MemoryBlock data;
+		float valNorm, valDenormDefault, valDenormDefaultOriginal;
+		{
+			audio::Processor processor;
+			auto param = processor.params[pID];
+			valDenormDefaultOriginal = param->getDefaultValueDenorm();
+			valNorm = param->getDefaultValue() > .5f ? .25f : .75f;
+			param->setValue(valNorm);
+			param->setDefaultValue(param->getValue());
+			valDenormDefault = param->getDefaultValueDenorm();
+			processor.getStateInformation(data);
+
+			// the defaults are shared with the other instances through the user settings, so put it back
+			param->setDefaultValue(param->range.convertTo0to1(valDenormDefaultOriginal));
+			juce::MemoryBlock discarded;
+			processor.getStateInformation(discarded);
+		}
+
+		audio::Processor processor;
+		processor.setStateInformation(data.getData(), static_cast<int>(data.getSize()));
+		const auto param = processor.params[pID];
+
+		// loading snaps to the legal values of the range
+		static constexpr float Eps = .0001f;
+		const auto valDefault = param->range.convertTo0to1(valDenormDefault);
+
+		auto valid = true;
+		if (std::abs(param->getValue() - valNorm) > Eps)
+		{
+			std::cout << "State: the value of " << param->getName(64) << " is " << param->getValue() << " instead of " << valNorm << "\n";
+			valid = false;
+		}
+		if (std::abs(param->getDefaultValue() - valDefault) > Eps)
+		{
+			std::cout << "State: the default of " << param->getName(64) << " is " << param->getDefaultValue() << " instead of " << valDefault << "\n";
+			valid = false;
+		}
+
+		// a corrupt patch with the magic must not fall back to the xml, nor change anything
+		auto corrupt = data;
+		static_cast<char*>(corrupt.getData())[corrupt.getSize() - 1] ^= 0x5a;
+		processor.setStateInformation(corrupt.getData(), static_cast<int>(corrupt.getSize()));
+		if (std::abs(param->getValue() - valNorm) > Eps)
+		{
+			std::cout << "State: a corrupt patch changed the value of " << param->getName(64) << " to " << param->getValue() << "\n";
+			valid = false;
+		}
+
+		std::cout << "state verified\n\n";
+		return valid;
+	}
+
+	/* blockSize, repetitions
+	the lookup of a formula defined stage curve, to compare against the skew kernels */
+	inline Result runCurve(int blockSize, int repetitions)
+	{
+		std::vector<float> x, bias, out(blockSize);
+		makeSkewInput(x, bias, blockSize);
+
+		audio::StageCurve curve;
+		curve.setFormula("sin(x * pi * .5)");
+		curve.update();
+
+		const auto numBlocks = std::max(1, SampleBudget / blockSize);
+		const auto numSamples = static_cast<double>(numBlocks) * blockSize;
+
+		Result result{ std::numeric_limits<double>::max(), std::numeric_limits<double>::max() };
+		for (auto r = 0; r < repetitions; ++r)
+		{
+			const auto c0 = cycles();
+			const auto t0 = Clock::now();
+			for (auto b = 0; b < numBlocks; ++b)
+				curve(out.data(), x.data(), blockSize);
+			const auto t1 = Clock::now();
+			const auto c1 = cycles();
+
+			const std::chrono::duration<double, std::nano> ns = t1 - t0;
+			result.nsPerSample = std::min(result.nsPerSample, ns.count() / numSamples);
+			result.cyclesPerSample = std::min(result.cyclesPerSample, static_cast<double>(c1 - c0) / numSamples);
+
+			volatile auto sink = out[blockSize - 1];
+			juce::ignoreUnused(sink);
+		}
+
+		return result;
+	}
+
+	/* kernel, blockSize, repetitions */
+	inline Result runSkew(skew::Func func, int blockSize, int repetitions)
+	{
+		std::vector<float> x, bias, out(blockSize);
+		makeSkewInput(x, bias, blockSize);
+
+		const auto numBlocks = std::max(1, SampleBudget / blockSize);
+		const auto numSamples = static_cast<double>(numBlocks) * blockSize;
+
+		Result result{ std::numeric_limits<double>::max(), std::numeric_limits<double>::max() };
+		for (auto r = 0; r < repetitions; ++r)
+		{
+			const auto c0 = cycles();
+			const auto t0 = Clock::now();
+			for (auto b = 0; b < numBlocks; ++b)
+				func(out.data(), x.data(), bias.data(), blockSize);
+			const auto t1 = Clock::now();
+			const auto c1 = cycles();
+
+			const std::chrono::duration<double, std::nano> ns = t1 - t0;
+			result.nsPerSample = std::min(result.nsPerSample, ns.count() / numSamples);
+			result.cyclesPerSample = std::min(result.cyclesPerSample, static_cast<double>(c1 - c0) / numSamples);
+
+			volatile auto sink = out[blockSize - 1];
+			juce::ignoreUnused(sink);
+		}
+
+		return result;
+	}
+
+	/* eventsPerBlock, blockSize, repetitions
+	delays midi by the maximum lookahead, with dense events, like arpeggiators or cc streams */
+	inline Result runMIDIDelay(int eventsPerBlock, int blockSize, int repetitions)
+	{
+		const auto delay = static_cast<int>(audio::msInSamples(EnvGenMIDI::MaxLatencyMs, Fs));
+		const auto capacity = (delay / blockSize + 2) * eventsPerBlock;
+
+		MIDIBuffer events, midi;
+		for (auto i = 0; i < eventsPerBlock; ++i)
+			events.addEvent(MIDIMessage::controllerEvent(1, 1, i % 128), i * blockSize / eventsPerBlock);
+		midi.ensureSize(static_cast<size_t>(events.data.size()) * 2);
+
+		const auto numBlocks = std::max(1, SampleBudget / blockSize);
+		const auto numSamples = static_cast<double>(numBlocks) * blockSize;
+
+		Result result{ std::numeric_limits<double>::max(), std::numeric_limits<double>::max() };
+		for (auto r = 0; r < repetitions; ++r)
+		{
+			audio::MIDIDelay midiDelay(capacity);
+
+			const auto c0 = cycles();
+			const auto t0 = Clock::now();
+			for (auto b = 0; b < numBlocks; ++b)
+			{
+				midi.clear();
+				midi.addEvents(events, 0, -1, 0);
+				midiDelay(midi, blockSize, delay);
+			}
+			const auto t1 = Clock::now();
+			const auto c1 = cycles();
+
+			const std::chrono::duration<double, std::nano> ns = t1 - t0;
+			result.nsPerSample = std::min(result.nsPerSample, ns.count() / numSamples);
+			result.cyclesPerSample = std::min(result.cyclesPerSample, static_cast<double>(c1 - c0) / numSamples);
+
+			if (midiDelay.getNumOverflows() != 0)
+				std::cout << "MIDIDelay: " << midiDelay.getNumOverflows() << " events dropped\n";
+		}
+
+		return result;
+	}
+
+	/* size, white noise [-1, 1] */
+	inline std::vector<float> makeNoise(int size)
+	{
+		std::mt19937 rng(420);
+		std::uniform_real_distribution<float> dist(-1.f, 1.f);
+		std::vector<float> noise(size);
+		for (auto& n : noise)
+			n = dist(rng);
+		return noise;
+	}
+
+	/* returns false if the envelope follower differs from the per-sample follower it replaced */
+	inline bool verifyEnvFol()
+	{
+		static constexpr int Size = 1 << 16;
+		static constexpr float RiseMs = 2.f;
+		static constexpr float FallMs = 40.f;
+
+		// the previous follower only changed its direction when the input crossed the envelope.
+		// every second sample equals the envelope, because the rise and fall coefficients
+		// round differently for some of them
+		auto x = makeNoise(Size);
+		std::vector<float> ref(Size), out(Size);
+		smooth::Lowpass<float> lowpass;
+		lowpass.makeFromDecayInMs(FallMs, Fs);
+		auto rising = false;
+		auto env = 0.f;
+		for (auto s = 0; s < Size; ++s)
+		{
+			x[s] = s % 2 == 0 ? std::abs(x[s]) : env;
+			if (rising ? env > x[s] : env < x[s])
+			{
+				rising = !rising;
+				lowpass.makeFromDecayInMs(rising ? RiseMs : FallMs, Fs);
+			}
+			env = lowpass(x[s]);
+			ref[s] = env;
+		}
+
+		auto valid = true;
+		const auto check = [&](const char* name)
+		{
+			auto numMismatches = 0;
+			for (auto s = 0; s < Size; ++s)
+				if (std::memcmp(&out[s], &ref[s], sizeof(float)) != 0)
+					++numMismatches;
+			if (numMismatches == 0)
+				return;
+			std::cout << "EnvFol/" << name << ": " << numMismatches << " samples differ from the previous follower\n";
+			valid = false;
+		};
+
+		{
+			// odd blocks, so that the state carries over at different samples
+			static constexpr int BlockSize = 61;
+			audio::EnvFol envFol;
+			envFol.prepare(Fs);
+			envFol.setTimes(RiseMs, FallMs);
+			for (auto s = 0; s < Size; s += BlockSize)
+				envFol(out.data() + s, x.data() + s, std::min(BlockSize, Size - s));
+			check("block");
+		}
+		{
+			audio::EnvFol envFol;
+			envFol.prepare(Fs);
+			envFol.setTimes(RiseMs, FallMs);
+			for (auto s = 0; s < Size; ++s)
+				out[s] = envFol.process(x[s]);
+			check("sample");
+		}
+
+		std::cout << "envelope follower verified\n\n";
+		return valid;
+	}
+
+	/* blockSize, repetitions
+	follows an audio rate signal, that switches between rise and fall every few samples */
+	inline Result runEnvFol(int blockSize, int repetitions)
+	{
+		auto x = makeNoise(blockSize);
+		for (auto& n : x)
+			n = std::abs(n);
+		std::vector<float> out(blockSize);
+
+		const auto numBlocks = std::max(1, SampleBudget / blockSize);
+		const auto numSamples = static_cast<double>(numBlocks) * blockSize;
+
+		Result result{ std::numeric_limits<double>::max(), std::numeric_limits<double>::max() };
+		for (auto r = 0; r < repetitions; ++r)
+		{
+			audio::EnvFol envFol;
+			envFol.prepare(Fs);
+
+			const auto c0 = cycles();
+			const auto t0 = Clock::now();
+			for (auto b = 0; b < numBlocks; ++b)
+				envFol(out.data(), x.data(), blockSize, 1.f, 42.f);
+			const auto t1 = Clock::now();
+			const auto c1 = cycles();
+
+			const std::chrono::duration<double, std::nano> ns = t1 - t0;
+			result.nsPerSample = std::min(result.nsPerSample, ns.count() / numSamples);
+			result.cyclesPerSample = std::min(result.cyclesPerSample, static_cast<double>(c1 - c0) / numSamples);
+
+			volatile auto sink = out[blockSize - 1];
+			juce::ignoreUnused(sink);
+		}
+
+		return result;
+	}
+
+	inline String toString(audio::LevelDetector::Mode mode)
+	{
+		using Mode = audio::LevelDetector::Mode;
+		switch (mode)
+		{
+		case Mode::Peak: return "Peak";
+		case Mode::RMS: return "RMS";
+		case Mode::TruePeak: return "TruePeak";
+		default: return "";
+		}
+	}
+
+	/* mode, blockSize, repetitions
+	the detector of the meters on a stereo signal, flushed once per meter frame */
+	inline Result runLevel(audio::LevelDetector::Mode mode, int blockSize, int repetitions)
+	{
+		const auto left = makeNoise(blockSize);
+		auto right = left;
+		std::reverse(right.begin(), right.end());
+		const float* samples[] = { left.data(), right.data() };
+
+		const auto windowLength = static_cast<int>(Fs / PPDFPSMeters);
+		const auto numBlocks = std::max(1, SampleBudget / blockSize);
+		const auto numSamples = static_cast<double>(numBlocks) * blockSize;
+
+		Result result{ std::numeric_limits<double>::max(), std::numeric_limits<double>::max() };
+		for (auto r = 0; r < repetitions; ++r)
+		{
+			audio::LevelDetector detector;
+			detector.prepare(blockSize, mode);
+			auto level = 0.f;
+			auto pos = 0;
+
+			const auto c0 = cycles();
+			const auto t0 = Clock::now();
+			for (auto b = 0; b < numBlocks; ++b)
+			{
+				detector(samples, 2, 0, blockSize);
+				pos += blockSize;
+				if (pos >= windowLength)
+				{
+					level = detector.flush(2);
+					pos -= windowLength;
+				}
+			}
+			const auto t1 = Clock::now();
+			const auto c1 = cycles();
+
+			const std::chrono::duration<double, std::nano> ns = t1 - t0;
+			result.nsPerSample = std::min(result.nsPerSample, ns.count() / numSamples);
+			result.cyclesPerSample = std::min(result.cyclesPerSample, static_cast<double>(c1 - c0) / numSamples);
+
+			volatile auto sink = level;
+			juce::ignoreUnused(sink);
+		}
+
+		return result;
+	}
+
+	inline void print(const String& name, const Result& result)
+	{
+		std::cout << std::left << std::setw(36) << name
+			<< std::right << std::fixed << std::setprecision(3)
+			<< std::setw(14) << result.nsPerSample
+			<< std::setw(16) << result.cyclesPerSample << "\n";
+	}
+
+	/* stage, tempoSync, blockSize, repetitions, numVoices */
+	inline Result run(Stage stage, bool tempoSync, int blockSize, int repetitions, int numVoices = 1)
+	{
+		const Config config(stage, tempoSync, numVoices);
+
+		MIDIBuffer empty, dense, chords, trigger;
+		trigger.addEvent(MIDIMessage::noteOn(1, 48, 1.f), 0);
+		for (auto s = 0; s < blockSize; s += 4)
+			if ((s / 4) % 2 == 0)
+				dense.addEvent(MIDIMessage::noteOn(1, 48, 1.f), s);
+			else
+				dense.addEvent(MIDIMessage::noteOff(1, 48), s);
+		// overlapping notes, so that all voices are busy most of the time
+		for (auto s = 0, n = 0; s < blockSize; s += 8, ++n)
+		{
+			chords.addEvent(MIDIMessage::noteOff(1, 36 + (n + numVoices / 2) % numVoices), s);
+			chords.addEvent(MIDIMessage::noteOn(1, 36 + n % numVoices, 1.f), s);
+		}
+		auto& midi = stage == Stage::Dense ? dense : stage == Stage::Poly ? chords : empty;
+
+		const auto numBlocks = std::max(1, SampleBudget / blockSize);
+		const auto numSamples = static_cast<double>(numBlocks) * blockSize;
+
+		Result result{ std::numeric_limits<double>::max(), std::numeric_limits<double>::max() };
+		for (auto r = 0; r < repetitions; ++r)
+		{
+			EnvGenMIDI envGen;
+			envGen.prepare(Fs, MaxBlockSize);
+
+			// bring the envelope into the stage under test and let the smoothers settle
+			config(envGen, trigger, blockSize);
+			if (stage == Stage::Release)
+			{
+				MIDIBuffer release;
+				release.addEvent(MIDIMessage::noteOff(1, 48), 0);
+				config(envGen, release, blockSize);
+			}
+			for (auto i = 0; i < MaxBlockSize * 4; i += blockSize)
+				config(envGen, empty, blockSize);
+
+			const auto c0 = cycles();
+			const auto t0 = Clock::now();
+			for (auto b = 0; b < numBlocks; ++b)
+				config(envGen, midi, blockSize);
+			const auto t1 = Clock::now();
+			const auto c1 = cycles();
+
+			const std::chrono::duration<double, std::nano> ns = t1 - t0;
+			result.nsPerSample = std::min(result.nsPerSample, ns.count() / numSamples);
+			result.cyclesPerSample = std::min(result.cyclesPerSample, static_cast<double>(c1 - c0) / numSamples);
+
+			// keeps the compiler from dropping the rendering
+			volatile auto sink = envGen[blockSize - 1];
+			juce::ignoreUnused(sink);
+		}
+
+		return result;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	using namespace bench;
+
+	const juce::ScopedJuceInitialiser_GUI juceInit;
+	const juce::ArgumentList args(argc, argv);
+	const auto filter = args.getValueForOption("--filter");
+	const auto repetitionsStr = args.getValueForOption("--repetitions");
+	const auto repetitions = repetitionsStr.isEmpty() ? 5 : std::max(1, repetitionsStr.getIntValue());
+
+	if (!verifySkewKernels() || !verifyEnvFol() || !verifyState())
+		return 1;
+	if (args.containsOption("--verify"))
+		return 0;
+
+	std::cout << std::left << std::setw(36) << "Benchmark"
+		<< std::right << std::setw(14) << "ns/sample"
+		<< std::setw(16) << "cycles/sample" << "\n"
+		<< String::repeatedString("-", 66) << "\n";
+
+	for (auto st = 0; st < static_cast<int>(Stage::NumStages); ++st)
+		for (auto tempoSync : { false, true })
+			for (auto blockSize = 16; blockSize <= MaxBlockSize; blockSize *= 2)
+			{
+				const auto stage = static_cast<Stage>(st);
+				const auto sync = String(tempoSync ? "sync" : "free");
+				if (stage != Stage::Poly)
+				{
+					const auto name = "EnvGen/" + toString(stage) + "/" + sync + "/" + String(blockSize);
+					if (filter.isNotEmpty() && !name.contains(filter))
+						continue;
+
+					print(name, run(stage, tempoSync, blockSize, repetitions));
+					continue;
+				}
+
+				for (auto numVoices : { 8, 16, 64 })
+				{
+					const auto name = "EnvGen/Poly" + String(numVoices) + "/" + sync + "/" + String(blockSize);
+					if (filter.isNotEmpty() && !name.contains(filter))
+						continue;
+
+					print(name, run(stage, tempoSync, blockSize, repetitions, numVoices));
+				}
+			}
+
+	for (auto k = 0; k < static_cast<int>(skew::Kernel::NumKernels); ++k)
+	{
+		const auto kernel = static_cast<skew::Kernel>(k);
+		const auto func = skew::getKernel(kernel);
+		if (func == nullptr)
+			continue;
+
+		for (auto blockSize = 16; blockSize <= MaxBlockSize; blockSize *= 2)
+		{
+			const auto name = "Skew/" + String(skew::toString(kernel)) + "/" + String(blockSize);
+			if (filter.isNotEmpty() && !name.contains(filter))
+				continue;
+
+			print(name, runSkew(func, blockSize, repetitions));
+		}
+	}
+
+	for (auto blockSize = 16; blockSize <= MaxBlockSize; blockSize *= 2)
+	{
+		const auto name = "Curve/" + String(blockSize);
+		if (filter.isNotEmpty() && !name.contains(filter))
+			continue;
+
+		print(name, runCurve(blockSize, repetitions));
+	}
+
+	for (auto eventsPerBlock : { 1, 16, 64 })
+		for (auto blockSize = 64; blockSize <= MaxBlockSize; blockSize *= 4)
+		{
+			const auto name = "MIDIDelay/" + String(eventsPerBlock) + "/" + String(blockSize);
+			if (filter.isNotEmpty() && !name.contains(filter))
+				continue;
+
+			print(name, runMIDIDelay(eventsPerBlock, blockSize, repetitions));
+		}
+
+	for (auto blockSize = 16; blockSize <= MaxBlockSize; blockSize *= 4)
+	{
+		const auto name = "EnvFol/" + String(blockSize);
+		if (filter.isNotEmpty() && !name.contains(filter))
+			continue;
+
+		print(name, runEnvFol(blockSize, repetitions));
+	}
+
+	for (auto m = 0; m < static_cast<int>(audio::LevelDetector::Mode::NumModes); ++m)
+		for (auto blockSize = 16; blockSize <= MaxBlockSize; blockSize *= 4)
+		{
+			const auto mode = static_cast<audio::LevelDetector::Mode>(m);
+			const auto name = "Level/" + toString(mode) + "/" + String(blockSize);
+			if (filter.isNotEmpty() && !name.contains(filter))
+				continue;
+
+			print(name, runLevel(mode, blockSize, repetitions));
+		}
+
+	return 0;
+}
@@ -0,0 +1,377 @@
+/*
+	ADSRRender: renders a midi file through audio::Processor without a plugin host.
+
+	usage:
+	ADSRRender <input.mid> <output.wav|output.raw> [options]
+
+	--samplerate <hz>			default 44100
+	--blocksize <samples>		default 512
+	--bpm <beats per minute>	default 120
+	--tail <seconds>			rendered after the last midi event, default 1
+	--repeat <n>				renders n times and reports the fastest run, default 1
+	--param "<name>=<value>"	sets a parameter to a denormalized value, can be repeated
+	--automation "<name>=<seconds>:<value>,<seconds>:<value>,..."
+								automates a parameter with denormalized values at sample accurate
+								positions, ramping linearly in between, and from the start of the
+								render to the first point. can be repeated
+	--curve "<attack|decay|release>=<formula of x>"
+								replaces the shape of a stage with a formula, can be repeated
+
+	"EnvGen Mode" defaults to Direct Out here, so that the output is the envelope itself.
+	The envelope is written as mono 32 bit float.
+	.raw files are headerless little endian floats.
+*/
+
+#include <chrono>
+#include <iostream>
+
+#include "Processor.h"
+#include <juce_audio_formats/juce_audio_formats.h>
+
+namespace render
+{
+	using String = juce::String;
+	using File = juce::File;
+	using MidiFile = juce::MidiFile;
+	using MidiSeq = juce::MidiMessageSequence;
+	using Clock = std::chrono::high_resolution_clock;
+
+	struct PlayHead :
+		public juce::AudioPlayHead
+	{
+		PlayHead(double _bpm, double _Fs) :
+			bpm(_bpm),
+			Fs(_Fs),
+			timeInSamples(0)
+		{}
+
+		juce::Optional<PositionInfo> getPosition() const override
+		{
+			PositionInfo info;
+			info.setBpm(bpm);
+			info.setIsPlaying(true);
+			info.setTimeInSamples(timeInSamples);
+			info.setTimeInSeconds(static_cast<double>(timeInSamples) / Fs);
+			info.setPpqPosition(static_cast<double>(timeInSamples) / Fs * bpm / 60.);
+			return info;
+		}
+
+		double bpm, Fs;
+		juce::int64 timeInSamples;
+	};
+
+	struct Options
+	{
+		File midiFile, outFile;
+		double sampleRate = 44100., bpm = 120., tail = 1.;
+		int blockSize = 512, repeat = 1;
+		juce::StringArray params { "EnvGen Mode=0" }, automation, curves;
+	};
+
+	struct AutomationPoint
+	{
+		// handOver is the sample of the parameter's previous point, where the ramp to this one starts
+		juce::int64 sample, handOver;
+		int paramIdx;
+		float valNorm;
+	};
+
+	static bool parse(Options& o, const juce::ArgumentList& args)
+	{
+		if (args.size() < 2)
+			return false;
+
+		o.midiFile = args[0].resolveAsFile();
+		o.outFile = args[1].resolveAsFile();
+
+		for (auto i = 2; i < args.size(); ++i)
+		{
+			const auto& arg = args[i];
+			if (i + 1 >= args.size())
+				return false;
+			const auto val = args[++i].text;
+
+			if (arg == "--samplerate")
+				o.sampleRate = val.getDoubleValue();
+			else if (arg == "--blocksize")
+				o.blockSize = val.getIntValue();
+			else if (arg == "--bpm")
+				o.bpm = val.getDoubleValue();
+			else if (arg == "--tail")
+				o.tail = val.getDoubleValue();
+			else if (arg == "--repeat")
+				o.repeat = val.getIntValue();
+			else if (arg == "--param")
+				o.params.add(val);
+			else if (arg == "--automation")
+				o.automation.add(val);
+			else if (arg == "--curve")
+				o.curves.add(val);
+			else
+				return false;
+		}
+
+		return o.sampleRate > 0. && o.blockSize > 0 && o.repeat > 0 && o.tail >= 0.;
+	}
+
+	static bool readMIDI(MidiSeq& seq, const File& file, double sampleRate)
+	{
+		juce::FileInputStream stream(file);
+		if (!stream.openedOk())
+			return false;
+
+		MidiFile midiFile;
+		if (!midiFile.readFrom(stream))
+			return false;
+		midiFile.convertTimestampTicksToSeconds();
+
+		for (auto t = 0; t < midiFile.getNumTracks(); ++t)
+			seq.addSequence(*midiFile.getTrack(t), 0.);
+		seq.updateMatchedPairs();
+
+		// timestamps from seconds to samples
+		for (auto e = 0; e < seq.getNumEvents(); ++e)
+		{
+			auto& msg = seq.getEventPointer(e)->message;
+			msg.setTimeStamp(std::round(msg.getTimeStamp() * sampleRate));
+		}
+
+		return true;
+	}
+
+	/* returns false on unknown parameter names or unparsable values */
+	static bool applyParams(audio::Processor& processor, const juce::StringArray& params)
+	{
+		for (const auto& p : params)
+		{
+			const auto name = p.upToFirstOccurrenceOf("=", false, false).trim();
+			const auto valStr = p.fromFirstOccurrenceOf("=", false, false).trim();
+
+			const auto idx = processor.params.getParamIdx(name);
+			if (idx == -1 || valStr.isEmpty())
+				return false;
+
+			auto param = processor.params[idx];
+			const auto val = param->getValForTextDenorm(valStr);
+			const auto legalVal = param->range.snapToLegalValue(val);
+			param->setValue(param->range.convertTo0to1(legalVal));
+		}
+		return true;
+	}
+
+	/* points, processor, automation, sampleRate
+	returns false on unknown parameter names or malformed points */
+	static bool makeAutomation(std::vector<AutomationPoint>& points, audio::Processor& processor,
+		const juce::StringArray& automation, double sampleRate)
+	{
+		points.clear();
+		for (const auto& a : automation)
+		{
+			const auto name = a.upToFirstOccurrenceOf("=", false, false).trim();
+			const auto idx = processor.params.getParamIdx(name);
+			if (idx == -1)
+				return false;
+			const auto param = processor.params[idx];
+
+			juce::StringArray tokens;
+			tokens.addTokens(a.fromFirstOccurrenceOf("=", false, false), ",", "");
+			for (const auto& t : tokens)
+			{
+				if (!t.containsChar(':'))
+					return false;
+				const auto secs = t.upToFirstOccurrenceOf(":", false, false).trim().getDoubleValue();
+				const auto val = param->getValForTextDenorm(t.fromFirstOccurrenceOf(":", false, false).trim());
+				const auto legalVal = param->range.snapToLegalValue(val);
+				const auto sample = static_cast<juce::int64>(std::round(secs * sampleRate));
+				points.push_back({ sample, 0, idx, param->range.convertTo0to1(legalVal) });
+			}
+		}
+
+		std::stable_sort(points.begin(), points.end(), [](const AutomationPoint& a, const AutomationPoint& b)
+		{
+			return a.sample < b.sample;
+		});
+
+		std::vector<juce::int64> lastSample(processor.params.numParams(), 0);
+		for (auto& point : points)
+		{
+			point.handOver = lastSample[point.paramIdx];
+			lastSample[point.paramIdx] = point.sample;
+		}
+		std::stable_sort(points.begin(), points.end(), [](const AutomationPoint& a, const AutomationPoint& b)
+		{
+			return a.handOver < b.handOver;
+		});
+		return true;
+	}
+
+	/* processor, playHead, seq, automation, envelope, numSamples, blockSize */
+	static void process(audio::Processor& processor, PlayHead& playHead, const MidiSeq& seq,
+		const std::vector<AutomationPoint>& automation, float* envelope, int numSamples, int blockSize)
+	{
+		const auto numChannels = processor.getTotalNumOutputChannels();
+		juce::AudioBuffer<float> buffer(numChannels, blockSize);
+		juce::MidiBuffer midi;
+		midi.ensureSize(2048);
+
+		auto evtIdx = 0;
+		size_t pointIdx = 0;
+		for (auto start = 0; start < numSamples; start += blockSize)
+		{
+			const auto numSamplesBlock = std::min(blockSize, numSamples - start);
+			const auto end = start + numSamplesBlock;
+
+			buffer.setSize(numChannels, numSamplesBlock, false, false, true);
+			buffer.clear();
+			midi.clear();
+
+			for (; evtIdx < seq.getNumEvents(); ++evtIdx)
+			{
+				const auto& msg = seq.getEventPointer(evtIdx)->message;
+				const auto ts = static_cast<int>(msg.getTimeStamp());
+				if (ts >= end)
+					break;
+				midi.addEvent(msg, ts - start);
+			}
+
+			// like a host, the automation is handed over right before the block is processed.
+			// every point comes with the block of its parameter's previous point, so that the ramp
+			// to it is known from its start and the output doesn't depend on the block size
+			for (; pointIdx < automation.size() && automation[pointIdx].handOver < end; ++pointIdx)
+			{
+				const auto& point = automation[pointIdx];
+				const auto offset = static_cast<int>(std::max(point.sample - start, juce::int64(0)));
+				processor.params[point.paramIdx]->setValue(point.valNorm, offset);
+			}
+
+			playHead.timeInSamples = start;
+			processor.processBlock(buffer, midi);
+
+			juce::FloatVectorOperations::copy(envelope + start, buffer.getReadPointer(0), numSamplesBlock);
+		}
+	}
+
+	static bool write(const File& file, const float* envelope, int numSamples, double sampleRate)
+	{
+		file.deleteFile();
+		auto stream = file.createOutputStream();
+		if (stream == nullptr)
+			return false;
+
+		if (file.hasFileExtension(".raw"))
+			return stream->write(envelope, sizeof(float) * static_cast<size_t>(numSamples));
+
+		juce::WavAudioFormat wav;
+		std::unique_ptr<juce::AudioFormatWriter> writer(wav.createWriterFor(stream.get(), sampleRate, 1, 32, {}, 0));
+		if (writer == nullptr)
+			return false;
+		stream.release();
+
+		const float* channels[] = { envelope, nullptr };
+		return writer->writeFromFloatArrays(channels, 1, numSamples);
+	}
+
+	/* returns false on unknown stage names or invalid formulas */
+	static bool applyCurves(audio::Processor& processor, const juce::StringArray& curves)
+	{
+		using State = audio::EnvGen::State;
+		for (const auto& c : curves)
+		{
+			const auto name = c.upToFirstOccurrenceOf("=", false, false).trim();
+			const auto formula = c.fromFirstOccurrenceOf("=", false, false).trim();
+
+			const auto stage =
+				name == "attack" ? State::Attack :
+				name == "decay" ? State::Decay :
+				name == "release" ? State::Release :
+				State::NumStates;
+			const auto curve = processor.envGenMIDI.getCurve(stage);
+			if (curve == nullptr || !curve->setFormula(formula))
+				return false;
+		}
+		return true;
+	}
+
+	static int run(const Options& o)
+	{
+		MidiSeq seq;
+		if (!readMIDI(seq, o.midiFile, o.sampleRate))
+		{
+			std::cerr << "could not read midi file: " << o.midiFile.getFullPathName() << "\n";
+			return 1;
+		}
+
+		const auto lastTs = seq.getNumEvents() == 0 ? 0. : seq.getEndTime();
+		const auto numSamples = static_cast<int>(lastTs + std::ceil(o.tail * o.sampleRate));
+		std::vector<float> envelope(static_cast<size_t>(numSamples), 0.f);
+
+		auto bestSecs = std::numeric_limits<double>::max();
+		for (auto r = 0; r < o.repeat; ++r)
+		{
+			audio::Processor processor;
+			if (!applyParams(processor, o.params))
+			{
+				std::cerr << "invalid --param argument\n";
+				return 1;
+			}
+			if (!applyCurves(processor, o.curves))
+			{
+				std::cerr << "invalid --curve argument\n";
+				return 1;
+			}
+
+			std::vector<AutomationPoint> automation;
+			if (!makeAutomation(automation, processor, o.automation, o.sampleRate))
+			{
+				std::cerr << "invalid --automation argument\n";
+				return 1;
+			}
+
+			PlayHead playHead(o.bpm, o.sampleRate);
+			processor.setPlayHead(&playHead);
+			processor.setRateAndBufferSizeDetails(o.sampleRate, o.blockSize);
+			processor.prepareToPlay(o.sampleRate, o.blockSize);
+
+			const auto startTime = Clock::now();
+			process(processor, playHead, seq, automation, envelope.data(), numSamples, o.blockSize);
+			const std::chrono::duration<double> secs = Clock::now() - startTime;
+			bestSecs = std::min(bestSecs, secs.count());
+
+			processor.releaseResources();
+			processor.setPlayHead(nullptr);
+		}
+
+		if (!write(o.outFile, envelope.data(), numSamples, o.sampleRate))
+		{
+			std::cerr << "could not write output file: " << o.outFile.getFullPathName() << "\n";
+			return 1;
+		}
+
+		const auto audioSecs = static_cast<double>(numSamples) / o.sampleRate;
+		const auto nsPerSample = numSamples == 0 ? 0. : bestSecs * 1e9 / static_cast<double>(numSamples);
+		std::cout << "samples: " << numSamples
+			<< ", blocksize: " << o.blockSize
+			<< ", render: " << bestSecs * 1000. << "ms"
+			<< ", realtime factor: " << (bestSecs > 0. ? audioSecs / bestSecs : 0.)
+			<< ", ns/sample: " << nsPerSample << "\n";
+
+		return 0;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	const juce::ScopedJuceInitialiser_GUI juceInit;
+	const juce::ArgumentList args(argc, argv);
+
+	render::Options options;
+	if (!render::parse(options, args))
+	{
+		std::cerr << "usage: ADSRRender <input.mid> <output.wav|output.raw> [--samplerate hz] [--blocksize n] "
+			"[--bpm bpm] [--tail secs] [--repeat n] [--param \"name=value\"]... "
+			"[--automation \"name=secs:value,...\"]... [--curve \"stage=formula\"]...\n";
+		return 1;
+	}
+
+	return render::run(options);
+}